@@ -1,81 +1,47 @@
+#include <algorithm>
+
 #include "attack.h"
 #include "position.h"
+#include "bitboard.h"
+#include "evaluate.h"
+
+// attackers_to() returns a bitboard of the pieces of both sides which attack the square,
+// using the given occupancy so that pieces can be removed for x-ray detection
+Bitboard attackers_to(Position& pos, Square square, Bitboard occupied) {
 
-int KnightMoves[8] = { 21, 19, 12, 8, -8, -12, -19, -21 };
-int BishopMoves[4] = { 11, 9, -9, -11 };
-int RookMoves[4] = { 10, 1, -1, -10 };
-int KingMoves[8] = { 11, 10, 9, 1, -1, -9, -10, -11 };
+	Square s = to64(square);
+
+	return (pawn_attacks[BLACK][s] & pos.pieces(WHITE, PAWN))
+		| (pawn_attacks[WHITE][s] & pos.pieces(BLACK, PAWN))
+		| (knight_attacks[s] & pos.pieces(KNIGHT))
+		| (king_attacks[s] & pos.pieces(KING))
+		| (bishop_attacks(s, occupied) & (pos.pieces(BISHOP) | pos.pieces(QUEEN)))
+		| (rook_attacks(s, occupied) & (pos.pieces(ROOK) | pos.pieces(QUEEN)));
+}
 
-// square_attacked() is a function which 
+// square_attacked() determines if any piece of the given side attacks the square
 bool square_attacked(Position& pos, Square square, Color side) {
 
-	// Pawns
-	if (side != WHITE) {
-		if (pos.piece_at(square + DELTA_NE) == B_PAWN || pos.piece_at(square + DELTA_NW) == B_PAWN)
-			return true;
-	} else {
-		if (pos.piece_at(square + DELTA_SE) == W_PAWN || pos.piece_at(square + DELTA_SW) == W_PAWN)
-			return true;
-	}
+	Square s = to64(square);
+	Bitboard occupied = pos.occupied();
 
-	Piece attacker;
-	Square offset;
+	// Pawns attack the square if a pawn of ours standing on it would attack them
+	if (pawn_attacks[!side][s] & pos.pieces(side, PAWN))
+		return true;
 
-	// Knight
-	for (int i = 0; i < 8; i++)
-	{
-		attacker = pos.piece_at(square + KnightMoves[i]);
-		if (type_of(attacker) == KNIGHT && color_of(attacker) == side)
-			return true;
-	}
+	if (knight_attacks[s] & pos.pieces(side, KNIGHT))
+		return true;
+
+	if (king_attacks[s] & pos.pieces(side, KING))
+		return true;
 
 	// Bishop and Queen
-	for (int i = 0; i < 4; i++)
-	{
-		offset = square;
-
-		while (true)
-		{
-			offset += BishopMoves[i];
-			attacker = pos.piece_at(offset);
-
-			if (!square_on_board(offset)) break;
-			if (attacker == NO_PIECE) continue;
-			if (color_of(attacker) == side)
-				if (type_of(attacker) == BISHOP || type_of(attacker) == QUEEN) return true;
-				else break;
-			else
-				break;
-		}
-	}
+	if (bishop_attacks(s, occupied) & (pos.pieces(side, BISHOP) | pos.pieces(side, QUEEN)))
+		return true;
 
 	// Rook and Queen
-	for (int i = 0; i < 4; i++)
-	{
-		offset = square;
-
-		while (true)
-		{
-			offset += RookMoves[i];
-			attacker = pos.piece_at(offset);
-
-			if (!square_on_board(offset)) break;
-			if (attacker == NO_PIECE) continue;
-			if (color_of(attacker) == side)
-				if (type_of(attacker) == ROOK || type_of(attacker) == QUEEN) return true;
-				else break;
-			else
-				break;
-		}
-	}
-
-	// King
-	for (int i = 0; i < 8; i++)
-	{
-		attacker = pos.piece_at(square + KingMoves[i]);
-		if (type_of(attacker) == KING && color_of(attacker) == side)
-			return true;
-	}
+	if (rook_attacks(s, occupied) & (pos.pieces(side, ROOK) | pos.pieces(side, QUEEN)))
+		return true;
 
 	return false;
 }
@@ -88,3 +54,142 @@ bool in_check(Position& pos) {
 	
 	return false;
 }
+
+// checkers() returns the enemy pieces giving check to the side to move
+Bitboard checkers(Position& pos) {
+
+	Color us = pos.to_move;
+
+	return attackers_to(pos, to120(lsb(pos.pieces(us, KING))), pos.occupied()) & pos.side_pieces(!us);
+}
+
+// pinned_pieces() returns the pieces of the side which are the only blocker
+// between their own king and an enemy slider
+Bitboard pinned_pieces(Position& pos, Color side) {
+
+	Square king = lsb(pos.pieces(side, KING));
+	Bitboard occupied = pos.occupied();
+	Bitboard pinned = 0;
+
+	// Enemy sliders which would attack the king on an empty board
+	Bitboard snipers = (rook_attacks(king, 0) & (pos.pieces(!side, ROOK) | pos.pieces(!side, QUEEN)))
+	                 | (bishop_attacks(king, 0) & (pos.pieces(!side, BISHOP) | pos.pieces(!side, QUEEN)));
+
+	while (snipers) {
+		Bitboard blockers = between_bb[king][pop_lsb(snipers)] & occupied;
+
+		if (blockers && !more_than_one(blockers))
+			pinned |= blockers & pos.side_pieces(side);
+	}
+
+	return pinned;
+}
+
+// gives_check() determines if the move gives check, without making it. Either the moved
+// piece attacks the enemy king from its new square, or it uncovers a slider of ours.
+bool gives_check(Position& pos, Move m) {
+
+	Color us = pos.to_move;
+	Square from = to64(from_sq(m));
+	Square to = to64(to_sq(m));
+	Square king = lsb(pos.pieces(!us, KING));
+	PieceType ptype = type_of(pos.piece_at(from_sq(m)));
+	Bitboard occupied = (pos.occupied() ^ square_bb[from]) | square_bb[to];
+
+	// After castling only the rook can give check
+	if (move_type(m) == CASTLING) {
+		Square rook_to = (to > from) ? to - 1 : to + 1;
+		Square rook_from = (to > from) ? to + 1 : to - 2;
+		occupied = (occupied ^ square_bb[rook_from]) | square_bb[rook_to];
+		return rook_attacks(rook_to, occupied) & square_bb[king];
+	}
+
+	if (move_type(m) == PROMOTION)
+		ptype = promotion_type(m);
+
+	// En-passant also uncovers the square of the captured pawn
+	if (move_type(m) == EN_PASSANT)
+		occupied ^= square_bb[(us == WHITE) ? to - 8 : to + 8];
+
+	Bitboard direct = (ptype == PAWN) ? pawn_attacks[us][to] : attacks_bb(ptype, to, occupied);
+	if (direct & square_bb[king])
+		return true;
+
+	// The moved piece is no longer on its from square to give a discovered check itself
+	Bitboard bishops = (pos.pieces(us, BISHOP) | pos.pieces(us, QUEEN)) & ~square_bb[from];
+	Bitboard rooks = (pos.pieces(us, ROOK) | pos.pieces(us, QUEEN)) & ~square_bb[from];
+
+	return (bishop_attacks(king, occupied) & bishops) || (rook_attacks(king, occupied) & rooks);
+}
+
+// see() runs the static exchange evaluation of a move, the material the side to move wins
+// or loses if both sides keep recapturing on the target square with their least valuable
+// attacker and may stop whenever continuing would lose. Pieces are only removed from an
+// occupancy bitboard, so sliders behind them join in as x-ray attackers.
+Value see(Position& pos, Move m) {
+
+	if (move_type(m) == CASTLING)
+		return 0;
+
+	Square from = to64(from_sq(m));
+	Square to = to64(to_sq(m));
+	Piece victim = pos.piece_at(to_sq(m));
+	Bitboard occupied = pos.occupied() ^ square_bb[from];
+	Value gain[32];
+	int d = 0;
+
+	// The piece now standing on the square is the next one to be captured
+	PieceType on_square = type_of(pos.piece_at(from_sq(m)));
+	gain[0] = (victim == NO_PIECE) ? 0 : value_of(type_of(victim));
+
+	if (move_type(m) == EN_PASSANT) {
+		occupied ^= square_bb[(pos.to_move == WHITE) ? to - 8 : to + 8];
+		gain[0] = value_of(PAWN);
+	}
+	else if (move_type(m) == PROMOTION) {
+		on_square = promotion_type(m);
+		gain[0] += value_of(on_square) - value_of(PAWN);
+	}
+
+	Bitboard diagonal = pos.pieces(BISHOP) | pos.pieces(QUEEN);
+	Bitboard straight = pos.pieces(ROOK) | pos.pieces(QUEEN);
+	Bitboard attackers = attackers_to(pos, to120(to), occupied) & occupied;
+	Color side = !pos.to_move;
+
+	while (true) {
+
+		Bitboard ours = attackers & pos.side_pieces(side);
+		if (!ours)
+			break;
+
+		// The king may only recapture when the opponent has nothing left to take back with
+		PieceType ptype = PAWN;
+		while (!(ours & pos.pieces(ptype)))
+			ptype++;
+
+		if (ptype == KING && (attackers & pos.side_pieces(!side)))
+			break;
+
+		d++;
+		gain[d] = value_of(on_square) - gain[d - 1];
+		occupied ^= square_bb[lsb(ours & pos.pieces(ptype))];
+
+		// Sliders lined up behind the piece that just captured
+		if (ptype == PAWN || ptype == BISHOP || ptype == QUEEN)
+			attackers |= bishop_attacks(to, occupied) & diagonal;
+		if (ptype == ROOK || ptype == QUEEN)
+			attackers |= rook_attacks(to, occupied) & straight;
+		attackers &= occupied;
+
+		on_square = ptype;
+		side = !side;
+	}
+
+	// Walk back through the sequence, each side may stand pat instead of capturing
+	while (d) {
+		gain[d - 1] = -max(-gain[d - 1], gain[d]);
+		d--;
+	}
+
+	return gain[0];
+}
@@ -4,8 +4,13 @@
 #include "types.h"
 #include "position.h"
 
+Bitboard attackers_to(Position& pos, Square square, Bitboard occupied);
 bool square_attacked(Position& pos, Square square, Color side);
 bool in_check(Position& pos);
+Bitboard checkers(Position& pos);
+Bitboard pinned_pieces(Position& pos, Color side);
+bool gives_check(Position& pos, Move m);
+Value see(Position& pos, Move m);
 
 // Test if a 120 index is on the legal board
 inline bool square_on_board(Square s) {
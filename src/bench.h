@@ -0,0 +1,11 @@
+#ifndef __BENCH_H__
+#define __BENCH_H__
+
+#include "types.h"
+
+extern const char* bench_positions[];
+extern const int bench_position_count;
+
+U64 bench(int depth, int thread_count, int hash_mb, bool json);
+
+#endif // !__BENCH_H__
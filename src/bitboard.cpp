@@ -0,0 +1,172 @@
+#include <cstring>
+
+#include "bitboard.h"
+#include "position.h"
+
+Bitboard square_bb[64];
+Bitboard file_bb[8];
+Bitboard rank_bb[8];
+Bitboard pawn_attacks[2][64];
+Bitboard knight_attacks[64];
+Bitboard king_attacks[64];
+Bitboard between_bb[64][64]; // squares strictly between two aligned squares
+Bitboard line_bb[64][64];    // the whole line through two aligned squares
+
+Magic bishop_magics[64];
+Magic rook_magics[64];
+
+// Shared attack tables which the magics index into
+Bitboard bishop_attack_table[0x1480];
+Bitboard rook_attack_table[0x19000];
+
+const int bishop_directions[4][2] = { { 1, 1 }, { 1, -1 }, { -1, 1 }, { -1, -1 } };
+const int rook_directions[4][2] = { { 1, 0 }, { -1, 0 }, { 0, 1 }, { 0, -1 } };
+
+// Small xorshift generator so the magics found are the same on every run
+class PRNG {
+	U64 s;
+
+public:
+	PRNG(U64 seed) : s(seed) {}
+
+	U64 rand() {
+		s ^= s >> 12, s ^= s << 25, s ^= s >> 27;
+		return s * 2685821657736338717ULL;
+	}
+
+	// Numbers with few set bits make good magic candidates
+	U64 sparse_rand() {
+		return rand() & rand() & rand();
+	}
+};
+
+// Returns the square bitboard if the file and rank are on the board
+Bitboard safe_square(int file, int rank) {
+	if (file < FILE_A || file > FILE_H || rank < RANK_1 || rank > RANK_8)
+		return 0;
+	return square_bb[rank * 8 + file];
+}
+
+// slow_attacks() walks each ray one square at a time, only used to build the tables
+Bitboard slow_attacks(const int directions[4][2], Square s, Bitboard occupied) {
+
+	Bitboard attacks = 0;
+
+	for (int i = 0; i < 4; i++) {
+		int f = file_of(s) + directions[i][0];
+		int r = rank_of(s) + directions[i][1];
+
+		for (Bitboard b; (b = safe_square(f, r)); f += directions[i][0], r += directions[i][1]) {
+			attacks |= b;
+			if (occupied & b)
+				break;
+		}
+	}
+
+	return attacks;
+}
+
+// init_magics() finds a magic number for every square and fills the attack table.
+// Every subset of the relevant occupancy mask is enumerated with the carry-rippler trick
+// and random sparse numbers are tried until one maps them all without a destructive collision.
+void init_magics(Magic magics[], Bitboard table[], const int directions[4][2]) {
+
+	static Bitboard occupancy[4096], reference[4096];
+	static int epoch[4096];
+	int current = 0;
+	int size = 0;
+	PRNG rng(1070372);
+
+	memset(epoch, 0, sizeof(epoch));
+
+	for (Square s = 0; s < 64; s++) {
+
+		Magic& m = magics[s];
+
+		// Board edges are not relevant unless the slider stands on them
+		Bitboard edges = ((rank_bb[RANK_1] | rank_bb[RANK_8]) & ~rank_bb[rank_of(s)])
+		               | ((file_bb[FILE_A] | file_bb[FILE_H]) & ~file_bb[file_of(s)]);
+
+		m.mask = slow_attacks(directions, s, 0) & ~edges;
+		m.shift = 64 - pop_count(m.mask);
+		m.attacks = (s == 0) ? table : magics[s - 1].attacks + size;
+
+		Bitboard b = 0;
+		size = 0;
+		do {
+			occupancy[size] = b;
+			reference[size] = slow_attacks(directions, s, b);
+			size++;
+			b = (b - m.mask) & m.mask;
+		} while (b);
+
+		for (int i = 0; i < size; ) {
+
+			for (m.magic = 0; pop_count((m.magic * m.mask) >> 56) < 6; )
+				m.magic = rng.sparse_rand();
+
+			// The epoch marks which table entries were written by the current attempt
+			for (++current, i = 0; i < size; i++) {
+				unsigned idx = m.index(occupancy[i]);
+
+				if (epoch[idx] < current) {
+					epoch[idx] = current;
+					m.attacks[idx] = reference[i];
+				}
+				else if (m.attacks[idx] != reference[i])
+					break;
+			}
+		}
+	}
+}
+
+namespace Bitboards {
+
+	void init() {
+
+		for (Square s = 0; s < 64; s++)
+			square_bb[s] = 1ULL << s;
+
+		for (int i = 0; i < 8; i++) {
+			file_bb[i] = FILE_A_BB << i;
+			rank_bb[i] = RANK_1_BB << (8 * i);
+		}
+
+		const int knight_steps[8][2] = { { 1, 2 }, { 2, 1 }, { 2, -1 }, { 1, -2 }, { -1, -2 }, { -2, -1 }, { -2, 1 }, { -1, 2 } };
+		const int king_steps[8][2] = { { 1, 1 }, { 1, 0 }, { 1, -1 }, { 0, -1 }, { -1, -1 }, { -1, 0 }, { -1, 1 }, { 0, 1 } };
+
+		for (Square s = 0; s < 64; s++) {
+			File f = file_of(s);
+			Rank r = rank_of(s);
+
+			pawn_attacks[WHITE][s] = safe_square(f - 1, r + 1) | safe_square(f + 1, r + 1);
+			pawn_attacks[BLACK][s] = safe_square(f - 1, r - 1) | safe_square(f + 1, r - 1);
+
+			knight_attacks[s] = king_attacks[s] = 0;
+			for (int i = 0; i < 8; i++) {
+				knight_attacks[s] |= safe_square(f + knight_steps[i][0], r + knight_steps[i][1]);
+				king_attacks[s] |= safe_square(f + king_steps[i][0], r + king_steps[i][1]);
+			}
+		}
+
+		init_magics(bishop_magics, bishop_attack_table, bishop_directions);
+		init_magics(rook_magics, rook_attack_table, rook_directions);
+
+		for (Square s1 = 0; s1 < 64; s1++) {
+			for (Square s2 = 0; s2 < 64; s2++) {
+
+				between_bb[s1][s2] = line_bb[s1][s2] = 0;
+
+				if (bishop_attacks(s1, 0) & square_bb[s2]) {
+					line_bb[s1][s2] = (bishop_attacks(s1, 0) & bishop_attacks(s2, 0)) | square_bb[s1] | square_bb[s2];
+					between_bb[s1][s2] = bishop_attacks(s1, square_bb[s2]) & bishop_attacks(s2, square_bb[s1]);
+				}
+				if (rook_attacks(s1, 0) & square_bb[s2]) {
+					line_bb[s1][s2] = (rook_attacks(s1, 0) & rook_attacks(s2, 0)) | square_bb[s1] | square_bb[s2];
+					between_bb[s1][s2] = rook_attacks(s1, square_bb[s2]) & rook_attacks(s2, square_bb[s1]);
+				}
+			}
+		}
+	}
+
+};
@@ -0,0 +1,88 @@
+#ifndef __BITBOARD_H__
+#define __BITBOARD_H__
+
+#include "types.h"
+
+// Bitboards use 64 based square indexes, A1 = bit 0 and H8 = bit 63
+
+namespace Bitboards {
+	void init();
+}
+
+const Bitboard FILE_A_BB = 0x0101010101010101ULL;
+const Bitboard RANK_1_BB = 0xFFULL;
+
+extern Bitboard square_bb[64];
+extern Bitboard file_bb[8];
+extern Bitboard rank_bb[8];
+extern Bitboard pawn_attacks[2][64];
+extern Bitboard knight_attacks[64];
+extern Bitboard king_attacks[64];
+extern Bitboard between_bb[64][64];
+extern Bitboard line_bb[64][64];
+
+// The Magic structure holds everything needed to look up the attacks of a slider
+// on a given square for any board occupancy
+struct Magic {
+	Bitboard mask;     // relevant occupancy squares, board edges excluded
+	Bitboard magic;    // multiplier which maps every relevant occupancy to a unique index
+	Bitboard* attacks; // pointer into the shared attack table
+	unsigned shift;    // 64 - number of relevant squares
+
+	unsigned index(Bitboard occupied) const {
+		return unsigned(((occupied & mask) * magic) >> shift);
+	}
+};
+
+extern Magic bishop_magics[64];
+extern Magic rook_magics[64];
+
+inline Bitboard bishop_attacks(Square s, Bitboard occupied) {
+	const Magic& m = bishop_magics[s];
+	return m.attacks[m.index(occupied)];
+}
+
+inline Bitboard rook_attacks(Square s, Bitboard occupied) {
+	const Magic& m = rook_magics[s];
+	return m.attacks[m.index(occupied)];
+}
+
+inline Bitboard queen_attacks(Square s, Bitboard occupied) {
+	return bishop_attacks(s, occupied) | rook_attacks(s, occupied);
+}
+
+// Returns the attacks of a non-pawn piece type standing on the square
+inline Bitboard attacks_bb(PieceType ptype, Square s, Bitboard occupied) {
+	switch (ptype) {
+		case KNIGHT: return knight_attacks[s];
+		case BISHOP: return bishop_attacks(s, occupied);
+		case ROOK:   return rook_attacks(s, occupied);
+		case QUEEN:  return queen_attacks(s, occupied);
+		case KING:   return king_attacks[s];
+		default:     return 0;
+	}
+}
+
+// Count the number of set bits
+inline int pop_count(Bitboard b) {
+	return __builtin_popcountll(b);
+}
+
+// Return the least significant square of a non-empty bitboard
+inline Square lsb(Bitboard b) {
+	assert(b);
+	return __builtin_ctzll(b);
+}
+
+// Return the least significant square and remove it from the bitboard
+inline Square pop_lsb(Bitboard& b) {
+	Square s = lsb(b);
+	b &= b - 1;
+	return s;
+}
+
+inline bool more_than_one(Bitboard b) {
+	return b & (b - 1);
+}
+
+#endif // !__BITBOARD_H__
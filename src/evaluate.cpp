@@ -1,24 +1,25 @@
-#include <cstring>
+#include <algorithm>
+
 #include "evaluate.h"
+#include "bitboard.h"
+#include "pawns.h"
 #include "movegen.h"
 #include "attack.h"
 
 const Value bishop_pair_bonus = 30;
-const Value passed_pawn_bonus[8] = { 0, 5, 10, 20, 35, 60, 100, 200 };
 const Value rook_open_file_bonus = 10;
 const Value rook_semi_open_file_bonus = 5;
 const Value queen_open_file_bonus = 5;
 const Value queen_semi_open_file_bonus = 3;
-const Value double_pawn_penalty = -15;
-
-// Maximum centipawn value for the engine to consider a position as an endgame
-const Value endgame_material = (value_of(ROOK) + 2 * value_of(KNIGHT) + 2 * value_of(PAWN));
 
 // Value of each type of piece from pawn to king
 Value piece_values[7] = { 0, 100, 300, 300, 500, 900, INFINITE_VALUE };
 
-// Array which holds information on the number of pawns on a file for each side
-int pawns_on_file[2][8] = {};
+// How much each type of piece counts towards the game phase, the starting position has MAX_PHASE
+int piece_phase[7] = { 0, 0, 1, 1, 2, 4, 0 };
+
+// Midgame and endgame piece square values for every piece on every 64 based square, filled by Eval::init()
+Value psq_value[PHASE_NB][13][64];
 
 // Table for mirroring the index of the lookup tables for black
 const int mirror64[64] = {
@@ -101,171 +102,90 @@ Value king_endgame_table[64] = {
 	0	,	0	,	0	,	0	,	0	,	0	,	0	,	0	
 };
 
-// evaluate() evaluates the given position, and returns it's score in centipawns
-Value evaluate(Position& pos) {
-
-	memset(pawns_on_file, 0, sizeof(pawns_on_file));
-
-	Value score;
-	Color us = pos.to_move;
-	Color them = !us;
-	PieceType type;
+namespace Eval {
 
-	score = pos.material[us] - pos.material[them];
-	//score += pos.mobility[us] - pos.mobility[them];
+	// init() builds the piece square lookup for both colors, mirroring the tables for black.
+	// Only the king has a separate endgame table.
+	void init() {
 
-	// Get pawn positions
-	for (int i = 0; i < 10; i++) {
-		Piece wpawn = pos.piece_list[create_piece(WHITE, PAWN)][i];
-		Piece bpawn = pos.piece_list[create_piece(BLACK, PAWN)][i];
+		for (Piece p = W_PAWN; p <= B_KING; p++) {
+			for (Square s = 0; s < 64; s++) {
 
-		if (wpawn)
-			pawns_on_file[WHITE][file_of(to64(wpawn))]++;
-		if (bpawn)
-			pawns_on_file[BLACK][file_of(to64(bpawn))]++;
-	}
+				Square rel = (color_of(p) == WHITE) ? s : mirror64[s];
+				Value mg = 0, eg;
 
-	// Loop through all the pieces
-	for (int i = W_PAWN; i <= B_KING; i++) {
-		
-		type = type_of(i);
-
-		// Loop through each piece in the piece list
-		for (int j = 0; j < pos.piece_num[i]; j++) {
-
-			Piece piece = i;
-			Square square = pos.piece_list[piece][j];
-
-			if (color_of(piece) == us) // if this is our piece, add to the value
-				score += table_value(pos, piece, square, us);
-			else
-				score -= table_value(pos, piece, square, us);
-
-			// evaluate pawns
-			if (type == PAWN) {
-				if (is_pawn_passed(piece, square)) {
-					Square s = (color_of(piece) == WHITE) ? to64(square) : mirror64[to64(square)];
-					Rank r = rank_of(s);
-					if (color_of(piece) == us)
-						score += passed_pawn_bonus[r];
-					else
-						score -= passed_pawn_bonus[r];
-				}
-				if (is_pawn_doubled(piece, square)) {
-					if (color_of(piece) == us)
-						score += double_pawn_penalty;
-					else
-						score -= double_pawn_penalty;
+				switch (type_of(p)) {
+					case PAWN:   mg = pawn_table[rel]; break;
+					case KNIGHT: mg = knight_table[rel]; break;
+					case BISHOP: mg = bishop_table[rel]; break;
+					case ROOK:   mg = rook_table[rel]; break;
+					case KING:   mg = king_midgame_table[rel]; break;
 				}
-			}
 
-			// evaluate rooks
-			if (type == ROOK) {
-				if (is_open_file(piece, square)) {
-					if (color_of(piece) == us)
-						score += rook_open_file_bonus;
-					else
-						score -= rook_open_file_bonus;
-				}
-				if (is_half_open_file(piece, square)) {
-					if (color_of(piece) == us)
-						score += rook_semi_open_file_bonus;
-					else
-						score -= rook_semi_open_file_bonus;
-				}
-			}
+				eg = (type_of(p) == KING) ? king_endgame_table[rel] : mg;
 
-			// evaluate queens
-			if (type == QUEEN) {
-				if (is_open_file(piece, square)) {
-					if (color_of(piece) == us)
-						score += queen_open_file_bonus;
-					else
-						score -= queen_open_file_bonus;
-				}
-				if (is_half_open_file(piece, square)) {
-					if (color_of(piece) == us)
-						score += queen_semi_open_file_bonus;
-					else
-						score -= queen_semi_open_file_bonus;
-				}
+				psq_value[MIDGAME][p][s] = mg;
+				psq_value[ENDGAME][p][s] = eg;
 			}
 		}
 	}
 
-	// Bishop Pair
-	if (pos.piece_num[create_piece(us, BISHOP)] >= 2 && pos.piece_num[create_piece(them, BISHOP)] < 2)
-		score += bishop_pair_bonus;
-	if (pos.piece_num[create_piece(us, BISHOP)] < 2 && pos.piece_num[create_piece(them, BISHOP)] >= 2)
-		score -= bishop_pair_bonus;
-
-	return score;
-}
+};
 
-// A function which returns the relative value for a piece on a square
-Value table_value(Position& pos, Piece p, Square s, Color side) {
+// evaluate() evaluates the given position, and returns it's score in centipawns.
+// Every search thread passes its own pawn hash table.
+Value evaluate(Position& pos, PawnTable& pawn_table) {
 
-	s = (color_of(p) == WHITE) ? to64(s) : mirror64[to64(s)];
+	Value score;
+	Color us = pos.to_move;
+	Color them = !us;
 
-	switch (type_of(p)) {
-		case PAWN:   return pawn_table[s];
-		case KNIGHT: return knight_table[s];
-		case BISHOP: return bishop_table[s];
-		case ROOK:   return rook_table[s];
-		case KING:   return (is_endgame(pos)) ? king_endgame_table[s] : king_midgame_table[s];
-		default:     return 0;
-	}
-}
+	score = pos.material[us] - pos.material[them];
 
-// determines if a position is in the endgame for the side to move
-bool is_endgame(Position& pos) {
-	return (pos.material[!pos.to_move] <= endgame_material) ? true : false;
-}
+	// Piece square tables, tapered between the midgame and endgame by the game phase
+	int phase = min(int(pos.phase), MAX_PHASE);
+	Value mg = pos.psq[MIDGAME][us] - pos.psq[MIDGAME][them];
+	Value eg = pos.psq[ENDGAME][us] - pos.psq[ENDGAME][them];
+	score += (mg * phase + eg * (MAX_PHASE - phase)) / MAX_PHASE;
 
-// determines if a pawn is passed
-bool is_pawn_passed(Piece p, Square s) {
+	// Pawn structure is cached in the pawn hash table
+	PawnEntry* pawns = probe_pawns(pawn_table, pos);
+	score += (us == WHITE) ? pawns->score : -pawns->score;
 
-	s = to64(s);
-	File pawnfile = file_of(s);
-	Color them = !color_of(p);
+	// Rooks and queens on open files, or files where only one side has pawns
+	Byte pawn_files = pawns->files[WHITE] | pawns->files[BLACK];
+	Byte half_open_files = pawns->files[WHITE] ^ pawns->files[BLACK];
 
-	Rank left = (pawnfile - 1 < FILE_A) ? FILE_A : pawnfile - 1; // If the file is less than the A File
-	Rank right = (pawnfile + 1 > FILE_H) ? FILE_H : pawnfile + 1; // if the file is greater than the H file
+	for (Color side = WHITE; side <= BLACK; side++) {
 
-	// if there are no enemy pawns on the left of, in front of, and to the right of our pawn, it is passed.
-	return (!pawns_on_file[them][left] && !pawns_on_file[them][pawnfile] && !pawns_on_file[them][right]) ? true : false;
-}
+		Value bonus = 0;
+		Bitboard rooks = pos.pieces(side, ROOK);
+		Bitboard queens = pos.pieces(side, QUEEN);
 
-// determines if a pawn is doubled
-bool is_pawn_doubled(Piece p, Square s) {
+		while (rooks) {
+			Byte file = 1 << file_of(pop_lsb(rooks));
+			if (!(pawn_files & file))
+				bonus += rook_open_file_bonus;
+			if (half_open_files & file)
+				bonus += rook_semi_open_file_bonus;
+		}
 
-	s = to64(s);
-	File pawnfile = file_of(s);
-	Color us = color_of(p);
+		while (queens) {
+			Byte file = 1 << file_of(pop_lsb(queens));
+			if (!(pawn_files & file))
+				bonus += queen_open_file_bonus;
+			if (half_open_files & file)
+				bonus += queen_semi_open_file_bonus;
+		}
 
-	return (pawns_on_file[us][pawnfile] > 1) ? true : false;
-}
+		score += (side == us) ? bonus : -bonus;
+	}
 
-// determines if a file is open of enemy and friendly pawns
-bool is_open_file(Piece p, Square s) {
-	s = to64(s);
-	File testfile = file_of(s);
-	Color them = !color_of(p);
-	// if they dont have any pawns on the file, and we dont have any pawns on the file return true
-	return (!pawns_on_file[them][testfile] && !pawns_on_file[!them][testfile]) ? true : false;
-}
+	// Bishop Pair
+	if (pos.piece_num[create_piece(us, BISHOP)] >= 2 && pos.piece_num[create_piece(them, BISHOP)] < 2)
+		score += bishop_pair_bonus;
+	if (pos.piece_num[create_piece(us, BISHOP)] < 2 && pos.piece_num[create_piece(them, BISHOP)] >= 2)
+		score -= bishop_pair_bonus;
 
-// same as the above function, except we only test for one pawn
-bool is_half_open_file(Piece p, Square s) {
-	s = to64(s);
-	File testfile = file_of(s);
-	Color them = !color_of(p);
-	
-	// there is probably an easier way to do this but I am tired
-	if (pawns_on_file[them][testfile] && !pawns_on_file[!them][testfile])
-		return true;
-	if (!pawns_on_file[them][testfile] && pawns_on_file[!them][testfile])
-		return true;
-
-	return false;
+	return score;
 }
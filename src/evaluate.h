@@ -3,16 +3,17 @@
 
 #include "types.h"
 #include "position.h"
+#include "pawns.h"
+
+namespace Eval {
+	void init();
+}
 
 extern Value piece_values[7];
+extern int piece_phase[7];
+extern Value psq_value[PHASE_NB][13][64];
 
-Value evaluate(Position& pos);
-Value table_value(Position& pos, Piece p, Square s, Color side);
-bool is_endgame(Position& pos);
-bool is_pawn_passed(Piece p, Square s);
-bool is_open_file(Piece p, Square s);
-bool is_half_open_file(Piece p, Square s);
-bool is_pawn_doubled(Piece p, Square s);
+Value evaluate(Position& pos, PawnTable& pawns);
 
 // helper function to return the value of a type of piece
 inline Value value_of(PieceType ptype) {
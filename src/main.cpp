@@ -1,15 +1,42 @@
 #include <iostream>
+#include <sstream>
+#include "bitboard.h"
 #include "position.h"
 #include "movegen.h"
+#include "evaluate.h"
+#include "search.h"
 #include "uci.h"
 
-int main()
+int main(int argc, char* argv[])
 {
 	cout << NAME << " by " << AUTHOR << endl;
 
+	Bitboards::init();
 	Position::init();
 	MoveGen::init();
+	Eval::init();
+	Search::init();
+
+	// Commands given on the command line run once instead of the UCI loop,
+	// "quokka perftsuite [depth]" exits with a non-zero status if a count is wrong.
+	// "quokka bench [depth] [threads] [hash] [json]" measures the search speed.
+	string command = (argc > 1) ? argv[1] : "";
+	string args;
+
+	for (int i = 2; i < argc; i++)
+		args += string(argv[i]) + " ";
+
+	istringstream iss(args);
+
+	if (command == "perftsuite")
+		return do_perft_suite(iss) ? EXIT_SUCCESS : EXIT_FAILURE;
+
+	if (command == "bench") {
+		do_bench(iss);
+		return 0;
+	}
+
 	UCI::loop();
 
 	return 0;
-}
\ No newline at end of file
+}
@@ -5,20 +5,10 @@
 #include "position.h"
 #include "movegen.h"
 #include "attack.h"
+#include "bitboard.h"
 
 using namespace std;
 
-// Offset array for piece movement
-Square offset[7][8] = {
-	0, 0, 0, 0, 0, 0, 0, 0,           // No Piece
-	0, 0, 0, 0, 0, 0, 0, 0,           // Pawn
-	21, 19, 12, 8, -8, -12, -19, -21, // Knight
-	11, 9, -9, -11, 0, 0, 0, 0,       // Bishop
-	10, 1, -1, -10, 0, 0, 0, 0,       // Rook
-	11, 10, 9, 1, -1, -9, -10, -11,   // Queen
-	11, 10, 9, 1, -1, -9, -10, -11    // King
-};
-
 // Lookup values for Most Valuable Victim - Least Valuable Aggressor
 const MoveScore victim_score[13] = { 0, 100, 200, 300, 400, 500, 600, 100, 200, 300, 400, 500, 600 };
 MoveScore MVV_LVA[13][13];
@@ -40,163 +30,149 @@ namespace MoveGen {
 
 };
 
-// Determines if the specified piece is a slider
-bool slider[7] = {
-	false, false, false, true, true, true, false
-};
-
-void get_psuedo_legals(Position& pos, MoveList& list) {
-	list = generate_pseudo_legal_moves(pos);
+// generate_captures() generates the legal moves the quiescence search looks at
+void generate_captures(Position& pos, MoveList& list) {
+	generate(pos, list, QUIESCENCE);
 }
 
-void get_psuedo_legal_captures(Position& pos, MoveList& list) {
-
-	MoveList pos_moves = {};
-	get_psuedo_legals(pos, pos_moves);
-
-	for (int i = 0; i < pos_moves.count; i++) {
-		if (pos.piece_at(pos_moves.moves[i].to) != NO_PIECE)
-			list.moves[list.count++] = pos_moves.moves[i];
-	}
+// is_capture() determines if the move captures a piece, including en-passant
+bool is_capture(Position& pos, Move m) {
+	return pos.piece_at(to_sq(m)) != NO_PIECE || move_type(m) == EN_PASSANT;
 }
 
+// generate_moves() generates every legal move
 void generate_moves(Position& pos, MoveList& list) {
-
-	MoveList pseudo_legals = generate_pseudo_legal_moves(pos);
-
-	for (int i = 0; i < pseudo_legals.count; i++) {
-		if (is_legal_move(pos, pseudo_legals.moves[i])) {
-			//Piece p = pos.piece_at(pseudo_legals.moves[i].from);
-			list.moves[list.count++] = pseudo_legals.moves[i];
-		}
-	}
+	generate(pos, list, ALL);
 }
 
-void generate_captures(Position& pos, MoveList& list) {
+// generate() generates only legal moves of the given type, for the pieces in from_mask.
+// Checkers and pinned pieces are found once, then pinned pieces may only move along their
+// pin ray, and in check the other pieces may only capture or block the checker.
+void generate(Position& pos, MoveList& list, GenType type, Bitboard from_mask) {
 
-	MoveList pos_moves = {};
-	generate_moves(pos, pos_moves);
-
-	for (int i = 0; i < pos_moves.count; i++) {
-		if (pos.piece_at(pos_moves.moves[i].to) != NO_PIECE)
-			list.moves[list.count++] = pos_moves.moves[i];
+	Color our_side = pos.to_move;
+	Color their_side = !our_side;
+	Bitboard occupied = pos.occupied();
+	Bitboard enemies = pos.side_pieces(their_side);
+	Square king = lsb(pos.pieces(our_side, KING));
+	Bitboard checking = checkers(pos);
+	Bitboard pinned = pinned_pieces(pos, our_side);
+	Square from_square, to_square;
+
+	// Destination squares for the type of move, pawns are handled separately
+	bool noisy = (type == CAPTURES || type == QUIESCENCE);
+	bool queen_only = (type == QUIESCENCE);
+
+	Bitboard type_targets = noisy ? enemies : (type == QUIETS) ? ~occupied : ~pos.side_pieces(our_side);
+
+	// King moves are tested with the king removed, so it can't step back along a slider's ray
+	Bitboard king_moves = (from_mask & square_bb[king]) ? king_attacks[king] & type_targets : 0;
+	while (king_moves) {
+		to_square = pop_lsb(king_moves);
+		if (!(attackers_to(pos, to120(to_square), occupied ^ square_bb[king]) & enemies))
+			add_move(pos, list, to120(king), to120(to_square));
 	}
 
-}
-
-bool move_compare(Move m1, Move m2) {
-	return m1.score > m2.score;
-}
-
-void sort_moves(MoveList& list) {
+	// In double check only the king can move
+	if (more_than_one(checking))
+		return;
 
-	sort(list.moves, list.moves + list.count, move_compare); 
+	// Squares the other pieces may move to
+	Bitboard targets = ~pos.side_pieces(our_side);
+	if (checking)
+		targets &= between_bb[king][lsb(checking)] | checking;
 
-}
-
-MoveList generate_pseudo_legal_moves(Position& pos) {
-
-	MoveList list = {};
-
-	Color our_side = pos.to_move;
-	Square N, S, NE, NW;
+	int up = (our_side == WHITE) ? 8 : -8;
+	Rank start_rank = (our_side == WHITE) ? RANK_2 : RANK_7;
+	Bitboard promotion_rank = (our_side == WHITE) ? rank_bb[RANK_8] : rank_bb[RANK_1];
 
-	N = (our_side == WHITE) ? DELTA_N : DELTA_S;
-	S = (our_side == WHITE) ? DELTA_S : DELTA_N;
-	NE = (our_side == WHITE) ? DELTA_NE : DELTA_SW;
-	NW = (our_side == WHITE) ? DELTA_NW : DELTA_SE;
-
-	Piece our_pawns = create_piece(our_side, PAWN);
+	// Captures and promotions count as captures, other pushes as quiets
+	Bitboard push_targets = noisy ? promotion_rank : (type == QUIETS) ? ~promotion_rank : ~0ULL;
 
 	// Loop through pawns
-	for (int i = 0; i < pos.piece_num[our_pawns]; i++) {
-		Square from_square = pos.piece_list[our_pawns][i];
-
-		// Capture left
-		Square to_square = from_square + NW;
-		if ((pos.piece_at(to_square) != NO_PIECE && color_of(pos.piece_at(to_square)) != our_side) || to_square == pos.en_passant_target)
-			add_pawn_move(pos, list, from_square, to_square);
-
-		// Capture right
-		to_square = from_square + NE;
-		if ((pos.piece_at(to_square) != NO_PIECE && color_of(pos.piece_at(to_square)) != our_side) || to_square == pos.en_passant_target)
-			add_pawn_move(pos, list, from_square, to_square);
-
-		// Advance forward
-		to_square = from_square + N;
-		if (pos.piece_at(to_square) == NO_PIECE) {
-			add_pawn_move(pos, list, from_square, to_square);
-
-			// If the square two squares behind our pawn is offboard, we're on the second rank and can push twice
-			if (!square_on_board(from_square + S + S) && pos.piece_at(to_square + N) == NO_PIECE)
-				add_pawn_move(pos, list, from_square, to_square + N);
+	Bitboard pawns = pos.pieces(our_side, PAWN) & from_mask;
+	while (pawns) {
+		from_square = pop_lsb(pawns);
+
+		Bitboard allowed = targets;
+		if (pinned & square_bb[from_square])
+			allowed &= line_bb[king][from_square];
+
+		// Captures
+		Bitboard captures = (type != QUIETS) ? pawn_attacks[our_side][from_square] & enemies & allowed : 0;
+		while (captures)
+			add_pawn_move(pos, list, to120(from_square), to120(pop_lsb(captures)), queen_only);
+
+		// Advance forward, and twice from the starting rank
+		to_square = from_square + up;
+		if (!(occupied & square_bb[to_square])) {
+			if (allowed & push_targets & square_bb[to_square])
+				add_pawn_move(pos, list, to120(from_square), to120(to_square), queen_only);
+
+			if (!noisy && rank_of(from_square) == start_rank && !(occupied & square_bb[to_square + up]) && (allowed & square_bb[to_square + up]))
+				add_pawn_move(pos, list, to120(from_square), to120(to_square + up));
 		}
-	}
 
-	// Loop from white/black Knight to white/black King and generate moves for each
-	for (PieceType ptype = KNIGHT; ptype <= KING; ptype++) {
+		// En-passant removes two pieces from the board, so simply test the king after the capture.
+		// This handles pins, checks by the captured pawn and the pawns uncovering a rank attack.
+		if (type != QUIETS && pos.en_passant_target != SQ_NONE && (pawn_attacks[our_side][from_square] & square_bb[to64(pos.en_passant_target)])) {
+			to_square = to64(pos.en_passant_target);
+			Square captured = to_square - up;
+			Bitboard after = (occupied ^ square_bb[from_square] ^ square_bb[captured]) | square_bb[to_square];
 
-		// Set our piece based on our side
-		Piece piece = create_piece(our_side, ptype);
-		Piece attacked = NO_PIECE;
+			if (!(attackers_to(pos, to120(king), after) & enemies & ~square_bb[captured]))
+				add_move(pos, list, to120(from_square), to120(to_square), EN_PASSANT);
+		}
+	}
 
-		// Loop through each piece in the list
-		for (int j = 0; j < pos.piece_num[piece]; j++) {
+	// Loop from white/black Knight to white/black Queen and generate moves for each
+	for (PieceType ptype = KNIGHT; ptype <= QUEEN; ptype++) {
 
-			Square from_square = pos.piece_list[piece][j]; // get the piece's starting square
+		Bitboard pieces = pos.pieces(our_side, ptype) & from_mask;
 
-			// Loop through each offset direction
-			for (int direction, offset_num = 0; offset_num < 8 && (direction = offset[ptype][offset_num]); offset_num++) {
+		while (pieces) {
+			from_square = pop_lsb(pieces);
 
-				// Add each step to the offset direction and make move if applicable
-				for (Square to_square = from_square + direction; square_on_board(to_square); to_square += direction) {
-					attacked = pos.piece_at(to_square);
+			Bitboard attacks = attacks_bb(ptype, from_square, occupied) & targets & type_targets;
+			if (pinned & square_bb[from_square])
+				attacks &= line_bb[king][from_square];
 
-					if (type_of(attacked) != NO_PIECE_TYPE && color_of(attacked) == our_side) break; // cannot capture our own color piece
-					add_move(pos, list, from_square, to_square); // Add the move
-					if (!slider[ptype]) break; // if this piece can't slide, stop going outwards
-					if (type_of(attacked) != NO_PIECE_TYPE) break; // we've captured a piece, we can't go further
-				}
-			}
+			while (attacks)
+				add_move(pos, list, to120(from_square), to120(pop_lsb(attacks)));
 		}
 	}
 
-	Piece our_king = create_piece(our_side, KING);
-	Square king_square = pos.piece_list[our_king][0];
-
-	// If we are not in check currently
-	if (!square_attacked(pos, king_square, !our_side)) {
+	// Castling, if we are not in check currently
+	if (!noisy && !checking && (from_mask & square_bb[king])) {
 
 		if (our_side == WHITE) {
 			if (!square_attacked(pos, F1, !our_side) && !square_attacked(pos, G1, !our_side) && (pos.castling_perms & WKCA))
 				if (pos.piece_at(F1) == NO_PIECE && pos.piece_at(G1) == NO_PIECE)
-					add_move(pos, list, E1, G1, NO_PIECE, true); // Castle Kingside
+					add_move(pos, list, E1, G1, CASTLING); // Castle Kingside
 			if (!square_attacked(pos, D1, !our_side) && !square_attacked(pos, C1, !our_side) && (pos.castling_perms & WQCA))
 				if (pos.piece_at(D1) == NO_PIECE && pos.piece_at(C1) == NO_PIECE && pos.piece_at(B1) == NO_PIECE)
-					add_move(pos, list, E1, C1, NO_PIECE, true); // Castle Queenside
+					add_move(pos, list, E1, C1, CASTLING); // Castle Queenside
 		}
 		else {
 			if (!square_attacked(pos, F8, !our_side) && !square_attacked(pos, G8, !our_side) && (pos.castling_perms & BKCA))
 				if (pos.piece_at(F8) == NO_PIECE && pos.piece_at(G8) == NO_PIECE)
-					add_move(pos, list, E8, G8, NO_PIECE, true); // Castle Kingside
+					add_move(pos, list, E8, G8, CASTLING); // Castle Kingside
 			if (!square_attacked(pos, D8, !our_side) && !square_attacked(pos, C8, !our_side) && (pos.castling_perms & BQCA))
 				if (pos.piece_at(D8) == NO_PIECE && pos.piece_at(C8) == NO_PIECE && pos.piece_at(B8) == NO_PIECE)
-					add_move(pos, list, E8, C8, NO_PIECE, true); // Castle Queenside
+					add_move(pos, list, E8, C8, CASTLING); // Castle Queenside
 		}
 	}
-
-	return list;
 }
 
 // add_pawn_move() handles everything to do with pawn moves
-void add_pawn_move(Position& pos, MoveList& list, Square from, Square to, Piece promotion) {
+void add_pawn_move(Position& pos, MoveList& list, Square from, Square to, bool queen_only) {
 
 	Square N = (pos.to_move == WHITE) ? DELTA_N : DELTA_S;
 
 	// we can tell if the pawn is entering the 8th rank because the destination square + north will be offboard
 	if (!square_on_board(to + N)) {
-		for (int i = KNIGHT; i <= QUEEN; i++) {
-			add_move(pos, list, from, to, create_piece(pos.to_move, i), false, 1000000 + (i * 10));
+		for (int i = queen_only ? QUEEN : KNIGHT; i <= QUEEN; i++) {
+			add_move(pos, list, from, to, PROMOTION, i, 1000000 + (i * 10));
 		}
 	}
 	else {
@@ -206,42 +182,24 @@ void add_pawn_move(Position& pos, MoveList& list, Square from, Square to, Piece
 }
 
 // add_move() adds a move to the move list
-void add_move(Position& pos, MoveList& list, Square from, Square to, Piece promotion, bool castle, MoveScore score) {
+void add_move(Position& pos, MoveList& list, Square from, Square to, int type, PieceType promotion, MoveScore score) {
 	
 	Piece attacker = pos.piece_at(from);
 	Piece attacked = pos.piece_at(to);
 
-	// Rank captures & non captures
-	if (attacked != NO_PIECE) {
+	// Rank captures, non captures are ordered by the search
+	if (attacked != NO_PIECE)
 		score += 900000 + MVV_LVA[attacked][attacker];
-	} else {
-		score += pos.cutoff_moves[from][to];
-	}
-
-	list.moves[list.count++] = create_move(from, to, promotion, castle, score);
-}
-
-// is_legal_move() determines if the move given will leave the king in check or not
-bool is_legal_move(Position& pos, Move m) {
-
-	Piece our_king = create_piece(pos.to_move, KING);
-	pos.make_move(m);
-
-	// If our king isn't in check after the move, we can add it to the list
-	if (!square_attacked(pos, pos.piece_list[our_king][0], pos.to_move)) {
-		pos.undo_move();
-		return true;
-	}
 
-	pos.undo_move();
-	return false;
+	list.moves[list.count].move = create_move(from, to, type, promotion);
+	list.moves[list.count++].score = score;
 }
 
 // move_in_list() returns the location of a move if it's in the specified move list
 int move_in_list(string& str, MoveList& list) {
 	string array_move;
 	for (int i = 0; i < list.count; i++) {
-		array_move = print_move(list.moves[i]);
+		array_move = print_move(list.moves[i].move);
 		if (array_move == str)
 			return i;
 	}
@@ -250,7 +208,7 @@ int move_in_list(string& str, MoveList& list) {
 
 void print_move_list(MoveList& list) {
 	for (int i = 0; i < list.count; i++) {
-		cout << print_move(list.moves[i]) << " ";
+		cout << print_move(list.moves[i].move) << " ";
 	}
 	cout << endl;
 }
@@ -8,16 +8,17 @@ namespace MoveGen {
 	void init();
 }
 
-void get_psuedo_legals(Position& pos, MoveList& list);
-void get_psuedo_legal_captures(Position& pos, MoveList& list);
+// Types of moves to generate, CAPTURES includes all promotions and QUIETS the rest.
+// QUIESCENCE is captures, en-passant and queen promotions only.
+enum GenType { CAPTURES, QUIETS, ALL, QUIESCENCE };
+
+void generate(Position& pos, MoveList& list, GenType type, Bitboard from_mask = ~0ULL);
 void generate_moves(Position& pos, MoveList& list);
 void generate_captures(Position& pos, MoveList& list);
-void sort_moves(MoveList& list);
-MoveList generate_pseudo_legal_moves(Position& pos);
-bool is_legal_move(Position& pos, Move m);
+bool is_capture(Position& pos, Move m);
 int move_in_list(string& str, MoveList& list);
-void add_move(Position& pos, MoveList& list, Square from, Square to, Piece promotion = NO_PIECE, bool castle = false, MoveScore score = 0);
-void add_pawn_move(Position& pos, MoveList& list, Square from, Square to, Piece promotion = NO_PIECE);
+void add_move(Position& pos, MoveList& list, Square from, Square to, int type = NORMAL, PieceType promotion = KNIGHT, MoveScore score = 0);
+void add_pawn_move(Position& pos, MoveList& list, Square from, Square to, bool queen_only = false);
 void print_move_list(MoveList& list);
 
 #endif // !__MOVEGEN_H__
@@ -0,0 +1,162 @@
+#include "movepick.h"
+#include "movegen.h"
+#include "attack.h"
+#include "bitboard.h"
+#include "evaluate.h"
+#include "tt.h"
+
+// Sort score which puts the killer moves ahead of the other quiet moves
+const MoveScore KILLER_SCORE = 800000;
+
+// Constructor for the main search, all stages
+MovePicker::MovePicker(Position& p, MoveList& buffer, SearchData& data, Move hm, int ply) : pos(p), list(buffer) {
+	sd = &data;
+	hash_move = hm;
+	killers[0] = sd->killers[ply][0];
+	killers[1] = sd->killers[ply][1];
+	stage = HASH_MOVE;
+	list.count = 0;
+}
+
+// Constructor for the quiescence search, only captures and queen promotions
+MovePicker::MovePicker(Position& p, MoveList& buffer, Move hm) : pos(p), list(buffer) {
+	sd = NULL;
+	hash_move = hm;
+	stage = Q_HASH_MOVE;
+	list.count = 0;
+}
+
+// MovePicker::find_hash_move() checks that the hash move is legal here by generating
+// the moves of the piece on its from square, keys can collide. The quiescence search
+// only accepts the moves generate_captures() would give it. The list is still empty
+// at this stage, so it is borrowed for the piece's moves and emptied again.
+bool MovePicker::find_hash_move() {
+
+	generate(pos, list, (sd == NULL) ? QUIESCENCE : ALL, square_bb[hash_move & 63]);
+
+	for (int i = 0; i < list.count; i++) {
+		if (list.moves[i].move == hash_move) {
+			list.count = 0;
+			return true;
+		}
+	}
+
+	list.count = 0;
+	hash_move = MOVE_NONE;
+	return false;
+}
+
+// MovePicker::pick_best() moves the highest scored move of the range to its front
+void MovePicker::pick_best(int from, int to) {
+
+	int best = from;
+
+	for (int i = from + 1; i < to; i++) {
+		if (list.moves[i].score > list.moves[best].score)
+			best = i;
+	}
+
+	swap(list.moves[from], list.moves[best]);
+}
+
+// MovePicker::next_move() returns false when there are no moves left
+bool MovePicker::next_move(Move& m) {
+
+	switch (stage) {
+
+	case HASH_MOVE:
+	case Q_HASH_MOVE:
+		stage++;
+		if (hash_move && find_hash_move()) {
+			m = hash_move;
+			return true;
+		}
+		// fallthrough
+
+	case GEN_CAPTURES:
+	case Q_GEN_CAPTURES:
+		if (stage == GEN_CAPTURES)
+			generate(pos, list, CAPTURES);
+		else
+			generate_captures(pos, list);
+		current = bad_end = 0;
+		end = list.count;
+		stage++;
+		// fallthrough
+
+	case GOOD_CAPTURES:
+	case Q_CAPTURES:
+		while (current < end) {
+			pick_best(current, end);
+			Move move = list.moves[current++].move;
+
+			if (move == hash_move)
+				continue;
+
+			// Captures which lose material in the exchange are kept at the front of the list
+			// and tried after the quiet moves
+			if (stage == GOOD_CAPTURES && see(pos, move) < 0) {
+				list.moves[bad_end++].move = move;
+				continue;
+			}
+
+			m = move;
+			return true;
+		}
+
+		if (stage == Q_CAPTURES) {
+			stage = PICKER_DONE;
+			return false;
+		}
+		stage++;
+		// fallthrough
+
+	case GEN_QUIETS:
+		generate(pos, list, QUIETS);
+
+		// Killers first, then by the history
+		for (int i = end; i < list.count; i++) {
+			ExtMove& quiet = list.moves[i];
+
+			if (quiet.move == killers[0])
+				quiet.score = KILLER_SCORE + 1;
+			else if (quiet.move == killers[1])
+				quiet.score = KILLER_SCORE;
+			else
+				quiet.score = history_of(*sd, pos.to_move, quiet.move);
+		}
+
+		current = end;
+		end = list.count;
+		stage++;
+		// fallthrough
+
+	case QUIET_MOVES:
+		while (current < end) {
+			pick_best(current, end);
+			Move move = list.moves[current++].move;
+
+			if (move == hash_move)
+				continue;
+
+			m = move;
+			return true;
+		}
+
+		current = 0;
+		stage++;
+		// fallthrough
+
+	case BAD_CAPTURES:
+		if (current < bad_end) {
+			m = list.moves[current++].move;
+			return true;
+		}
+
+		stage = PICKER_DONE;
+		// fallthrough
+
+	default:
+		return false;
+	}
+}
@@ -0,0 +1,40 @@
+#ifndef __MOVEPICK_H__
+#define __MOVEPICK_H__
+
+#include "types.h"
+#include "position.h"
+#include "search.h"
+
+// Stages of the move picker, in the order they are visited
+enum {
+	HASH_MOVE, GEN_CAPTURES, GOOD_CAPTURES, GEN_QUIETS, QUIET_MOVES, BAD_CAPTURES,
+	Q_HASH_MOVE, Q_GEN_CAPTURES, Q_CAPTURES,
+	PICKER_DONE
+};
+
+// The MovePicker class hands out the moves of a node one at a time, best first.
+// Moves are generated stage by stage, so a node which cuts off on the hash move
+// or a capture never generates its quiet moves, and only the moves actually tried
+// are selected from the list instead of sorting all of it. The list is not part of
+// the picker, every ply reuses its own buffer so nothing is cleared or copied.
+class MovePicker {
+
+public:
+	MovePicker(Position& pos, MoveList& buffer, SearchData& sd, Move hash_move, int ply);
+	MovePicker(Position& pos, MoveList& buffer, Move hash_move);
+	bool next_move(Move& m);
+
+private:
+	Position& pos;
+	SearchData* sd;
+	Move killers[2];
+	Move hash_move;
+	int stage;
+	int current, end, bad_end;
+	MoveList& list; // the move list of this ply, owned by the search thread
+
+	bool find_hash_move();
+	void pick_best(int from, int to);
+};
+
+#endif // !__MOVEPICK_H__
@@ -0,0 +1,66 @@
+#include <cstring>
+
+#include "pawns.h"
+#include "bitboard.h"
+
+const Value passed_pawn_bonus[8] = { 0, 5, 10, 20, 35, 60, 100, 200 };
+const Value double_pawn_penalty = -15;
+
+PawnTable pawn_hash;
+
+// evaluate_pawns() scores the pawns of one side and fills in its file mask
+Value evaluate_pawns(Position& pos, Color side, PawnEntry* entry) {
+
+	Value score = 0;
+	Bitboard ours = pos.pieces(side, PAWN);
+	Bitboard theirs = pos.pieces(!side, PAWN);
+	Bitboard pawns = ours;
+
+	for (File f = FILE_A; f <= FILE_H; f++) {
+		if (ours & file_bb[f])
+			entry->files[side] |= 1 << f;
+	}
+
+	while (pawns) {
+		Square s = pop_lsb(pawns);
+		File f = file_of(s);
+		Bitboard files = file_bb[f]
+		               | ((f > FILE_A) ? file_bb[f - 1] : 0)
+		               | ((f < FILE_H) ? file_bb[f + 1] : 0);
+
+		// if there are no enemy pawns on the left of, in front of, and to the right of our pawn, it is passed.
+		if (!(theirs & files))
+			score += passed_pawn_bonus[(side == WHITE) ? rank_of(s) : RANK_8 - rank_of(s)];
+
+		if (more_than_one(ours & file_bb[f]))
+			score += double_pawn_penalty;
+	}
+
+	return score;
+}
+
+// probe_pawns() returns the table entry for the pawn structure of the position,
+// evaluating the structure and replacing the old entry on a miss
+PawnEntry* probe_pawns(PawnTable& table, Position& pos) {
+
+	PawnEntry* entry = &table.entries[pos.pawn_key & (PAWN_TABLE_SIZE - 1)];
+
+	table.probes++;
+
+	if (entry->key == pos.pawn_key) {
+		table.hits++;
+		return entry;
+	}
+
+	entry->key = pos.pawn_key;
+	entry->files[WHITE] = entry->files[BLACK] = 0;
+	entry->score = evaluate_pawns(pos, WHITE, entry) - evaluate_pawns(pos, BLACK, entry);
+
+	return entry;
+}
+
+// clear_pawn_table() empties the table and its counters
+void clear_pawn_table(PawnTable& table) {
+	memset(table.entries, 0, sizeof(table.entries));
+	table.probes = table.hits = 0;
+}
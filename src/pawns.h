@@ -0,0 +1,29 @@
+#ifndef __PAWNS_H__
+#define __PAWNS_H__
+
+#include "types.h"
+#include "position.h"
+
+// Number of entries in the pawn hash table, must be a power of two
+const int PAWN_TABLE_SIZE = 16384;
+
+// The PawnEntry structure caches the evaluation of one pawn structure
+struct PawnEntry {
+	Key key;       // pawn key of the structure
+	int16_t score; // passed and doubled pawn terms from white's point of view
+	Byte files[2]; // one bit per file which holds a white / black pawn
+};
+
+// The PawnTable structure is a fixed size hash table of pawn structures
+struct PawnTable {
+	PawnEntry entries[PAWN_TABLE_SIZE];
+	Counter probes;
+	Counter hits;
+};
+
+extern PawnTable pawn_hash; // pawn table used outside of the search
+
+PawnEntry* probe_pawns(PawnTable& table, Position& pos);
+void clear_pawn_table(PawnTable& table);
+
+#endif // !__PAWNS_H__
@@ -1,22 +1,234 @@
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <iostream>
+#include <new>
+#include <thread>
+#include <vector>
+
 #include "perft.h"
 
-U64 perft(Position& pos, int depth) {
+PerftTable::PerftTable(size_t mb) {
+
+	size_t entries = mb * 1024 * 1024 / sizeof(PerftEntry);
+
+	entry_count = 1;
+	while (entry_count * 2 <= entries)
+		entry_count *= 2;
+
+	// If the memory isn't there, carry on with the largest table which fits
+	while (!(table = new (nothrow) PerftEntry[entry_count]) && entry_count > 1)
+		entry_count /= 2;
+
+	if (!table) {
+		cerr << "Failed to allocate " << mb << "MB for the perft hash" << endl;
+		exit(EXIT_FAILURE);
+	}
+
+	if (entry_count * sizeof(PerftEntry) < mb * 1024 * 1024 / 2)
+		cerr << "Failed to allocate " << mb << "MB for the perft hash, using "
+		     << entry_count * sizeof(PerftEntry) / 1024 << "KB" << endl;
+
+	memset(table, 0, entry_count * sizeof(PerftEntry));
+}
+
+PerftTable::~PerftTable() {
+	delete[] table;
+}
+
+bool PerftTable::probe(Key key, int depth, U64& nodes) {
+
+	PerftEntry& entry = table[(key ^ depth) & (entry_count - 1)];
+	U64 data = entry.data;
+
+	if ((entry.key ^ data) != key || int(data & 0xFF) != depth)
+		return false;
+
+	nodes = data >> 8;
+	return true;
+}
+
+void PerftTable::store(Key key, int depth, U64 nodes) {
+
+	PerftEntry& entry = table[(key ^ depth) & (entry_count - 1)];
+	U64 data = (nodes << 8) | depth;
+
+	entry.data = data;
+	entry.key = key ^ data;
+}
+
+// perft() counts the leaf nodes of the legal move tree. The moves at depth 1 are
+// counted without being made, and subtrees already seen are taken from the hash.
+U64 perft(Position& pos, int depth, PerftTable* hash) {
 
-	//int num_moves = 0;
 	U64 nodes = 0;
 
 	if (depth == 0)
 		return 1;
 
-	MoveList mlist = {};
+	if (hash && depth > 1 && hash->probe(pos.pos_key, depth, nodes))
+		return nodes;
+
+	MoveList mlist;
+	mlist.count = 0;
 	generate_moves(pos, mlist);
-	sort_moves(mlist);
+
+	if (depth == 1)
+		return mlist.count;
 
 	for (int i = 0; i < mlist.count; i++) {
-		pos.make_move(mlist.moves[i]);
-		nodes += perft(pos, depth - 1);
+		pos.make_move(mlist.moves[i].move);
+		nodes += perft(pos, depth - 1, hash);
 		pos.undo_move();
 	}
 
+	if (hash)
+		hash->store(pos.pos_key, depth, nodes);
+
 	return nodes;
 }
+
+// perft_root() splits the root moves between the threads, which take the next move
+// from a shared counter until none are left. Every thread has its own copy of the
+// position and history, the hash is shared. Divide prints the counts in root move order.
+U64 perft_root(Position& pos, int depth, bool divide, int thread_count, PerftTable* hash) {
+
+	if (depth < 1)
+		return 1;
+
+	MoveList root;
+	root.count = 0;
+	generate_moves(pos, root);
+
+	vector<U64> counts(root.count);
+	atomic<int> next(0);
+
+	auto worker = [&]() {
+		GameHistory history;
+		Position copy = pos;
+
+		copy.set_history(&history);
+		memcpy(history.stack, pos.history, pos.game_ply * sizeof(Snapshot));
+
+		for (int i = next++; i < root.count; i = next++) {
+			copy.make_move(root.moves[i].move);
+			counts[i] = perft(copy, depth - 1, hash);
+			copy.undo_move();
+		}
+	};
+
+	vector<std::thread> workers;
+	for (int i = 1; i < min(thread_count, root.count); i++)
+		workers.push_back(std::thread(worker));
+
+	worker();
+
+	for (size_t i = 0; i < workers.size(); i++)
+		workers[i].join();
+
+	U64 nodes = 0;
+
+	for (int i = 0; i < root.count; i++) {
+		if (divide)
+			cout << print_move(root.moves[i].move) << ": " << counts[i] << endl;
+		nodes += counts[i];
+	}
+
+	return nodes;
+}
+
+// run_perft() runs perft on the position and reports the node count, time and NPS
+U64 run_perft(Position& pos, int depth, bool divide, int thread_count, size_t hash_mb) {
+
+	PerftTable* hash = hash_mb ? new PerftTable(hash_mb) : NULL;
+	int start = get_time();
+
+	U64 nodes = perft_root(pos, depth, divide, thread_count, hash);
+
+	int elapsed = get_time() - start;
+	delete hash;
+
+	cout << "Nodes at depth " << depth << ": " << nodes << endl;
+	cout << "Time: " << elapsed << " ms" << endl;
+	cout << "NPS: " << nodes * 1000 / max(elapsed, 1) << endl;
+
+	return nodes;
+}
+
+// Positions of the perft suite with their known node counts from depth 1 up, 0 ends the list.
+// The start position, Kiwipete and the other standard test positions, then small positions
+// for en-passant pins, promotions, castling through check and discovered checks.
+struct PerftTest {
+	const char* fen;
+	U64 nodes[7];
+};
+
+const PerftTest perft_tests[] = {
+	{ "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", { 20, 400, 8902, 197281, 4865609 } },
+	{ "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1", { 48, 2039, 97862, 4085603 } },
+	{ "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1", { 14, 191, 2812, 43238, 674624, 11030083 } },
+	{ "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1", { 6, 264, 9467, 422333, 15833292 } },
+	{ "r2q1rk1/pP1p2pp/Q4n2/bbp1p3/Np6/1B3NBn/pPPP1PPP/R3K2R b KQ - 0 1", { 6, 264, 9467, 422333, 15833292 } },
+	{ "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8", { 44, 1486, 62379, 2103487 } },
+	{ "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10", { 46, 2079, 89890, 3894594 } },
+	{ "3k4/3p4/8/K1P4r/8/8/8/8 b - - 0 1", { 18, 92, 1670, 10138, 185429, 1134888 } },
+	{ "8/8/4k3/8/2p5/8/B2P2K1/8 w - - 0 1", { 13, 102, 1266, 10276, 135655, 1015133 } },
+	{ "8/5bk1/8/2Pp4/8/1K6/8/8 w - d6 0 1", { 8, 104, 736, 9287, 62297, 824064 } },
+	{ "8/8/1k6/2b5/2pP4/8/5K2/8 b - d3 0 1", { 15, 126, 1928, 13931, 206379, 1440467 } },
+	{ "5k2/8/8/8/8/8/8/4K2R w K - 0 1", { 15, 66, 1198, 6399, 120330, 661072 } },
+	{ "r3k2r/8/3Q4/8/8/5q2/8/R3K2R b KQkq - 0 1", { 44, 1494, 50509, 1720476 } },
+	{ "r3k2r/1b4bq/8/8/8/8/7B/R3K2R w KQkq - 0 1", { 26, 1141, 27826, 1274206 } },
+	{ "2K2r2/4P3/8/8/8/8/8/3k4 w - - 0 1", { 11, 133, 1442, 19174, 266199, 3821001 } },
+	{ "8/8/1P2K3/8/2n5/1q6/8/5k2 b - - 0 1", { 29, 165, 5160, 31961, 1004658, 6334638 } },
+	{ "4k3/1P6/8/8/8/8/K7/8 w - - 0 1", { 9, 40, 472, 2661, 38983, 217342 } },
+	{ "8/P1k5/K7/8/8/8/8/8 w - - 0 1", { 6, 27, 273, 1329, 18135, 92683 } },
+	{ "K1k5/8/P7/8/8/8/8/8 w - - 0 1", { 2, 6, 13, 63, 382, 2217 } },
+	{ "8/k1P5/8/1K6/8/8/8/8 w - - 0 1", { 10, 25, 268, 926, 10857, 43261 } },
+	{ "8/8/2k5/5q2/5n2/8/5K2/8 b - - 0 1", { 37, 183, 6559, 23527, 811573, 3114998 } }
+};
+
+// perft_suite() runs every suite position to the deepest known count, or to max_depth
+// if that is lower, and compares the results. It returns false if any count is wrong.
+bool perft_suite(int max_depth, int thread_count, size_t hash_mb) {
+
+	int count = sizeof(perft_tests) / sizeof(PerftTest);
+	int passed = 0;
+	U64 total_nodes = 0;
+	int total_time = 0;
+
+	for (int i = 0; i < count; i++) {
+
+		const PerftTest& test = perft_tests[i];
+		int depth = 0;
+
+		while (depth < 7 && test.nodes[depth] && (max_depth <= 0 || depth < max_depth))
+			depth++;
+
+		GameHistory history;
+		Position pos(test.fen, &history);
+
+		// A fresh hash for every position, so one wrong count can't leak into the next
+		PerftTable* hash = hash_mb ? new PerftTable(hash_mb) : NULL;
+		int start = get_time();
+
+		U64 nodes = perft_root(pos, depth, false, thread_count, hash);
+
+		int elapsed = get_time() - start;
+		delete hash;
+
+		bool ok = (nodes == test.nodes[depth - 1]);
+		passed += ok;
+		total_nodes += nodes;
+		total_time += elapsed;
+
+		cout << (ok ? "ok   " : "FAIL ") << "depth " << depth << " nodes " << nodes;
+		if (!ok)
+			cout << " expected " << test.nodes[depth - 1];
+		cout << " time " << elapsed << " ms  " << test.fen << endl;
+	}
+
+	cout << "perftsuite: " << passed << "/" << count << " passed, " << total_nodes << " nodes in "
+	     << total_time << " ms, nps " << total_nodes * 1000 / max(total_time, 1) << endl;
+
+	return passed == count;
+}
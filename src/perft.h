@@ -5,6 +5,30 @@
 #include "movegen.h"
 #include "position.h"
 
-U64 perft(Position& pos, int depth);
+// The PerftEntry structure stores the node count of a position at a depth. Like the
+// transposition table, the key is XORed with the data so threads can share it without locks.
+struct PerftEntry {
+	Key key;
+	U64 data; // node count in bits 8-63, depth in bits 0-7
+};
 
-#endif // !__PERF_H__
\ No newline at end of file
+// The PerftTable class is an always replace hash table of (key, depth) -> node count
+class PerftTable {
+
+public:
+	PerftTable(size_t mb);
+	~PerftTable();
+	bool probe(Key key, int depth, U64& nodes);
+	void store(Key key, int depth, U64 nodes);
+
+private:
+	PerftEntry* table;
+	size_t entry_count;
+};
+
+U64 perft(Position& pos, int depth, PerftTable* hash = NULL);
+U64 perft_root(Position& pos, int depth, bool divide, int thread_count, PerftTable* hash);
+U64 run_perft(Position& pos, int depth, bool divide, int thread_count, size_t hash_mb);
+bool perft_suite(int max_depth, int thread_count, size_t hash_mb);
+
+#endif // !__PERF_H__
@@ -8,7 +8,8 @@
 #include "position.h"
 #include "movegen.h"
 #include "attack.h"
-#include "evaluate.h" // value_of
+#include "evaluate.h" // value_of, psq_value
+#include "bitboard.h"
 
 using namespace std;
 
@@ -28,17 +29,6 @@ Key piece_keys[13][120];
 Key side_key;
 Key castle_keys[16];
 
-// Helper function to create a move
-Move create_move(Square from, Square to, Piece promotion, bool castle, int score) {
-	Move m;
-	m.from = from;
-	m.to = to;
-	m.promotion = promotion;
-	m.castle = castle;
-	m.score = score;
-	return m;
-}
-
 // Convert a 120 based square to it's algebraic notation
 string coord(Square s) {
 
@@ -56,9 +46,9 @@ string coord(Square s) {
 // Convert a move into readable text
 string print_move(Move m) {
 	ostringstream oss;
-	oss << coord(m.from) << coord(m.to);
-	if (m.promotion != NO_PIECE)
-		oss << char(tolower(PieceToChar[m.promotion]));
+	oss << coord(from_sq(m)) << coord(to_sq(m));
+	if (move_type(m) == PROMOTION)
+		oss << char(tolower(PieceToChar[promotion_type(m)]));
 	return oss.str();
 }
 
@@ -75,7 +65,7 @@ void parse_UCI_move(Position& pos, string& str) {
 	int index = move_in_list(str, mlist);
 
 	if (index != -1) {
-		pos.make_move(mlist.moves[index]);
+		pos.make_move(mlist.moves[index].move);
 	}
 }
 
@@ -133,20 +123,31 @@ void Position::init() {
 }
 
 // Default constructor
-Position::Position() {
+Position::Position(GameHistory* game) {
+	history = NULL;
 	clear();
+	set_history(game);
 }
 
 // Overloaded constructor
-Position::Position(const string fen) {
+Position::Position(const string fen, GameHistory* game) {
+	history = NULL;
 	clear();
+	set_history(game);
 	parse_fen(fen);
 }
 
-// Clear the position object and set everything to default data
+// Position::set_history() attaches the position to the history stack of a game
+void Position::set_history(GameHistory* game) {
+	history = (game != NULL) ? game->stack : NULL;
+}
+
+// Clear the position object and set everything to default data, keeping the attached history
 void Position::clear() {
+	Snapshot* game = history;
 	memset(this, 0, sizeof(Position));
 	en_passant_target = SQ_NONE;
+	history = game;
 }
 
 // Position::parse_fen() parses a Forsyth-Edwards Notation string to be used on the internal game board
@@ -204,35 +205,47 @@ void Position::parse_fen(const string& fen) {
 	// 5. Halfmove and fullmove
 	ss >> skipws >> rule50 >> game_ply;
 	game_ply = max(2 * (game_ply - 1), 0) + int(to_move == BLACK);
+	start_ply = game_ply;
+
+	// This is the only time the key is built from scratch, make_move() keeps it updated
+	pos_key = generate_position_key();
 }
 
 // Position::make_move() moves a piece while keeping piece lists in sync.
 void Position::make_move(Move m, bool save) {
 
-	Piece p = piece_at(m.from);
-	Piece attacked = piece_at(m.to);
-	m.captured = attacked;
+	Square from = from_sq(m);
+	Square to = to_sq(m);
+	Piece p = piece_at(from);
+	Piece attacked = piece_at(to);
 
 	assert(type_of(p) != NO_PIECE);
 
-	if (save)
-		take_snapshot(m);
+	if (save) {
+		take_snapshot(m, attacked);
 
-	remove_piece(m.from, p);
+		// Remove the old en-passant and castling state from the key
+		if (en_passant_target != SQ_NONE)
+			pos_key ^= piece_keys[NO_PIECE][en_passant_target];
+
+		pos_key ^= castle_keys[castling_perms];
+	}
+
+	remove_piece(from, p);
 
 	if (attacked != NO_PIECE)
-		remove_piece(m.to, attacked);
+		remove_piece(to, attacked);
 
 	// Change piece if we are promoting
-	if (m.promotion > NO_PIECE)
-		p = m.promotion;
+	if (move_type(m) == PROMOTION)
+		p = create_piece(to_move, promotion_type(m));
 
-	add_piece(m.to, p);
+	add_piece(to, p);
 
 	// Save the position state to the history and then change any positional values
 	if (save) {
 		handle_en_passant(p, m);
-		parse_castling(p, m);
+		parse_castling(p, m, attacked);
 
 		// Set 50 move rule to 0 if a pawn moved or a piece was captured
 		if (type_of(p) == PAWN || attacked != NO_PIECE)
@@ -242,8 +255,8 @@ void Position::make_move(Move m, bool save) {
 
 		to_move = (to_move == WHITE) ? BLACK : WHITE;
 
-		if (to_move == WHITE)
-			pos_key ^= side_key;
+		// Add the new side, en-passant and castling state to the key
+		pos_key ^= side_key;
 
 		if (en_passant_target != SQ_NONE)
 			pos_key ^= piece_keys[NO_PIECE][en_passant_target];
@@ -251,8 +264,14 @@ void Position::make_move(Move m, bool save) {
 		pos_key ^= castle_keys[castling_perms];
 	}
 
-	if (m.castle)
+	// The rook move goes through add_piece() and remove_piece() so it is hashed too
+	if (move_type(m) == CASTLING)
 		do_castling(m);
+
+#ifdef KEY_CHECK
+	if (save)
+		check_key();
+#endif
 }
 
 // Position::undo_move() takes back the last move in the position object based on the move list
@@ -260,8 +279,10 @@ void Position::undo_move() {
 
 	assert(game_ply > 0);
 
-	Snapshot snap = history_stack[--game_ply];
+	Snapshot snap = history[--game_ply];
 	Move m = snap.move;
+	Square from = from_sq(m);
+	Square to = to_sq(m);
 
 	castling_perms = snap.castling_perms;
 	en_passant_target = snap.en_passant_target;
@@ -269,43 +290,80 @@ void Position::undo_move() {
 	to_move = (to_move == WHITE) ? BLACK : WHITE;
 
 	// Move our piece back to its original square
-	Piece p = piece_at(m.to);
+	Piece p = piece_at(to);
 
-	remove_piece(m.to, p);
+	remove_piece(to, p);
 
 	// If it was a capture, restore the original piece
-	if (m.captured != NO_PIECE)
-		add_piece(m.to, m.captured);
+	if (snap.captured != NO_PIECE)
+		add_piece(to, snap.captured);
 
 	// If it was a pawn promotion, restore the pawn
-	if (m.promotion > NO_PIECE)
+	if (move_type(m) == PROMOTION)
 		p = (to_move == WHITE) ? W_PAWN : B_PAWN;
 
-	add_piece(m.from, p);
+	add_piece(from, p);
 
 	// Undo en passant
-	if (type_of(p) == PAWN && m.to == en_passant_target) {
+	if (move_type(m) == EN_PASSANT) {
 		if (to_move == WHITE) {
-			add_piece(m.to + DELTA_S, B_PAWN);
+			add_piece(to + DELTA_S, B_PAWN);
 		}
 		else {
-			add_piece(m.to + DELTA_N, W_PAWN);
+			add_piece(to + DELTA_N, W_PAWN);
 		}
 	}
 
-	if (m.castle)
+	if (move_type(m) == CASTLING)
 		undo_castling(m);
 
 	pos_key = snap.id;
+
+#ifdef KEY_CHECK
+	check_key();
+#endif
+}
+
+// Position::make_null_move() passes the turn to the other side, for null move pruning.
+// The 50 move counter starts again so repetitions are not searched for across the null move.
+void Position::make_null_move() {
+
+	take_snapshot(MOVE_NONE, NO_PIECE);
+
+	if (en_passant_target != SQ_NONE)
+		pos_key ^= piece_keys[NO_PIECE][en_passant_target];
+
+	en_passant_target = SQ_NONE;
+	rule50 = 0;
+	to_move = !to_move;
+	pos_key ^= side_key;
+
+#ifdef KEY_CHECK
+	check_key();
+#endif
+}
+
+// Position::undo_null_move() takes back a null move
+void Position::undo_null_move() {
+
+	assert(game_ply > 0);
+
+	Snapshot snap = history[--game_ply];
+
+	en_passant_target = snap.en_passant_target;
+	rule50 = snap.rule50;
+	to_move = !to_move;
+	pos_key = snap.id;
 }
 
 // Position::parse_castling() forbids castling if the rooks or king move or if the rook is captured
-void Position::parse_castling(Piece p, Move m) {
+void Position::parse_castling(Piece p, Move m, Piece captured) {
 
 	PieceType moved = type_of(p);
+	Square from = from_sq(m);
 
-	if (type_of(m.captured) == ROOK) {
-		switch (m.to) {
+	if (type_of(captured) == ROOK) {
+		switch (to_sq(m)) {
 			case H8: clear_bit(castling_perms, BKCA); break;
 			case A8: clear_bit(castling_perms, BQCA); break;
 			case H1: clear_bit(castling_perms, WKCA); break;
@@ -314,7 +372,7 @@ void Position::parse_castling(Piece p, Move m) {
 	}
 	
 	if (moved == ROOK) {
-		switch (m.from) {
+		switch (from) {
 			case A8: clear_bit(castling_perms, BQCA); break;
 			case H8: clear_bit(castling_perms, BKCA); break;
 			case A1: clear_bit(castling_perms, WQCA); break;
@@ -327,23 +385,23 @@ void Position::parse_castling(Piece p, Move m) {
 		return;
 
 	if (to_move == WHITE) {
-		if (m.from == E1) {
+		if (from == E1) {
 			clear_bit(castling_perms, WKCA);
 			clear_bit(castling_perms, WQCA);
 		}
-		if (m.from == A1 && (castling_perms & WQCA))
+		if (from == A1 && (castling_perms & WQCA))
 			clear_bit(castling_perms, WQCA);
-		if (m.from == H1 && (castling_perms & WKCA))
+		if (from == H1 && (castling_perms & WKCA))
 			clear_bit(castling_perms, WKCA);
 	}
 	else {
-		if (m.from == E8) {
+		if (from == E8) {
 			clear_bit(castling_perms, BKCA);
 			clear_bit(castling_perms, BQCA);
 		}
-		if (m.from == A8 && (castling_perms & WQCA))
+		if (from == A8 && (castling_perms & WQCA))
 			clear_bit(castling_perms, BQCA);
-		if (m.from == H8 && (castling_perms & WKCA))
+		if (from == H8 && (castling_perms & WKCA))
 			clear_bit(castling_perms, BKCA);
 	}
 }
@@ -356,25 +414,28 @@ void Position::handle_en_passant(Piece p, Move m) {
 		return;
 	}
 
+	Square from = from_sq(m);
+	Square to = to_sq(m);
+
 	// If the move is capturing our target, capture the target pawn
-	if (m.to == en_passant_target) {
+	if (move_type(m) == EN_PASSANT) {
 		if (to_move == WHITE)
-			remove_piece(m.to + DELTA_S, B_PAWN);
+			remove_piece(to + DELTA_S, B_PAWN);
 		else
-			remove_piece(m.to + DELTA_N, W_PAWN);
+			remove_piece(to + DELTA_N, W_PAWN);
 	}
 
 	// If the pawn moved from the 2nd rank to the 4th
 	if (to_move == WHITE) {
-		if (rank_of(to64(m.from)) == 1 && rank_of(to64(m.to)) == 3)
-			en_passant_target = m.from += DELTA_N;
+		if (rank_of(to64(from)) == 1 && rank_of(to64(to)) == 3)
+			en_passant_target = from + DELTA_N;
 		else
 			en_passant_target = SQ_NONE;
 	}
 	// If the pawn moved from the 7th rank to the 5th
 	else {
-		if (rank_of(to64(m.from)) == 6 && rank_of(to64(m.to)) == 4)
-			en_passant_target = m.from += DELTA_S;
+		if (rank_of(to64(from)) == 6 && rank_of(to64(to)) == 4)
+			en_passant_target = from + DELTA_S;
 		else
 			en_passant_target = SQ_NONE;
 	}
@@ -384,13 +445,11 @@ void Position::handle_en_passant(Piece p, Move m) {
 // This doesn't check if the move was valid, that is left up to the move generator
 void Position::do_castling(Move m) {
 
-	m.castle = false;
-
-	switch (m.to) {
-		case G1: m.from = H1; m.to = F1; break;
-		case C1: m.from = A1; m.to = D1; break;
-		case G8: m.from = H8; m.to = F8; break;
-		case C8: m.from = A8; m.to = D8; break;
+	switch (to_sq(m)) {
+		case G1: m = create_move(H1, F1); break;
+		case C1: m = create_move(A1, D1); break;
+		case G8: m = create_move(H8, F8); break;
+		case C8: m = create_move(A8, D8); break;
 	}
 		
 	make_move(m, false);
@@ -399,13 +458,11 @@ void Position::do_castling(Move m) {
 // Position::undo_castling() reverses the castling action.
 void Position::undo_castling(Move m) {
 
-	m.castle = false;
-
-	switch (m.to) {
-		case G1: m.from = F1; m.to = H1; break;
-		case C1: m.from = D1; m.to = A1; break;
-		case G8: m.from = F8; m.to = H8; break;
-		case C8: m.from = D8; m.to = A8; break;
+	switch (to_sq(m)) {
+		case G1: m = create_move(F1, H1); break;
+		case C1: m = create_move(D1, A1); break;
+		case G8: m = create_move(F8, H8); break;
+		case C8: m = create_move(D8, A8); break;
 	}
 
 	make_move(m, false);
@@ -422,6 +479,8 @@ void Position::remove_piece(Square s, Piece p) {
 
 	int index = SQ_NONE;
 	board[s] = NO_PIECE;
+	by_type[type_of(p)] ^= square_bb[to64(s)];
+	by_color[color_of(p)] ^= square_bb[to64(s)];
 
 	// loop through piece list and get index of the piece on from square
 	for (int i = 0; i < piece_num[p]; i++)
@@ -443,44 +502,55 @@ void Position::remove_piece(Square s, Piece p) {
 	if (type_of(p) != KING)
 		material[color_of(p)] -= value_of(type_of(p));
 
+	psq[MIDGAME][color_of(p)] -= psq_value[MIDGAME][p][to64(s)];
+	psq[ENDGAME][color_of(p)] -= psq_value[ENDGAME][p][to64(s)];
+	phase -= piece_phase[type_of(p)];
+
 	pos_key ^= piece_keys[p][s];
+
+	if (type_of(p) == PAWN)
+		pawn_key ^= piece_keys[p][s];
 }
 
 // Position::put_piece() Inserts a piece in the 120 based board array and piece list
 void Position::add_piece(Square s, Piece p) {
 
 	board[s] = p;
+	by_type[type_of(p)] |= square_bb[to64(s)];
+	by_color[color_of(p)] |= square_bb[to64(s)];
 	piece_list[p][piece_num[p]++] = s;
 	
 	if (type_of(p) != KING)
 		material[color_of(p)] += value_of(type_of(p));
 
+	psq[MIDGAME][color_of(p)] += psq_value[MIDGAME][p][to64(s)];
+	psq[ENDGAME][color_of(p)] += psq_value[ENDGAME][p][to64(s)];
+	phase += piece_phase[type_of(p)];
+
 	pos_key ^= piece_keys[p][s];
+
+	if (type_of(p) == PAWN)
+		pawn_key ^= piece_keys[p][s];
 }
 
 // Position::take_snapshot() saves the current state of the board to the history stack
-void Position::take_snapshot(Move m) {
+void Position::take_snapshot(Move m, Piece captured) {
 
 	Snapshot snap;
 
+	assert(history != NULL);
+
 	snap.castling_perms = castling_perms;
 	snap.en_passant_target = en_passant_target;
 	snap.rule50 = rule50;
 	snap.move = m;
-
-	// If we have no base position key, generate one, otherwise use the dynamically updated one
-	snap.id = (game_ply == 0) ? generate_position_key() : pos_key;
-
-	if (game_ply == 0) {
-		pos_key = generate_position_key();
-	}
-	
+	snap.captured = captured;
 	snap.id = pos_key;
 
-	history_stack[game_ply++] = snap;
+	history[game_ply++] = snap;
 }
 
-// Position::generate_position_key() generates a unique hash key for the position to check for repetition draws
+// Position::generate_position_key() generates a unique hash key for the position from scratch
 Key Position::generate_position_key() {
 
 	Key poskey = 0;
@@ -488,7 +558,7 @@ Key Position::generate_position_key() {
 	// Add piece locations from piece list for each type and number of piece
 	for (int i = W_PAWN; i <= B_KING; i++) {
 		for (int j = 0; j < piece_num[i]; j++) {
-			poskey ^= piece_keys[i][j];
+			poskey ^= piece_keys[i][piece_list[i][j]];
 		}
 	}
 
@@ -503,6 +573,32 @@ Key Position::generate_position_key() {
 	return poskey;
 }
 
+#ifdef KEY_CHECK
+// Position::check_key() verifies the incrementally updated keys against a full recompute
+void Position::check_key() {
+
+	if (pos_key != generate_position_key()) {
+		cout << "key mismatch at ply " << game_ply << ": incremental " << uppercase << hex << pos_key
+		     << " recomputed " << generate_position_key() << dec << endl;
+		print_board();
+		assert(false);
+	}
+
+	Key pawns = 0;
+
+	for (int i = 0; i < piece_num[W_PAWN]; i++)
+		pawns ^= piece_keys[W_PAWN][piece_list[W_PAWN][i]];
+	for (int i = 0; i < piece_num[B_PAWN]; i++)
+		pawns ^= piece_keys[B_PAWN][piece_list[B_PAWN][i]];
+
+	if (pawn_key != pawns) {
+		cout << "pawn key mismatch at ply " << game_ply << endl;
+		print_board();
+		assert(false);
+	}
+}
+#endif
+
 // Position::print_board() displays the internal board to the console in a pretty fashion
 void Position::print_board() {
 
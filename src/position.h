@@ -1,6 +1,7 @@
 #ifndef __POSITION_H__
 #define __POSITION_H__
 
+#include <cstdint>
 #include <string>
 #include "types.h"
 
@@ -11,31 +12,50 @@ extern Square sq64_to_120[120];
 
 extern PieceType piece_type[13];
 
+// The GameHistory structure holds the snapshots of the moves played so far.
+// It lives outside of the position so that copying a position stays cheap.
+struct GameHistory {
+	Snapshot stack[MAX_GAME_MOVES];
+};
+
+// The Position class only holds the board state, packed into narrow types.
+// The fields used by move generation and make_move() come first so they share the first cache lines.
 class Position {
 
 public:
-	Piece board[120]; // Board array
-	Value material[2]; // Material count for both black and white players
-	MoveScore cutoff_moves[120][120]; // Array which holds moves that caused an alpha cutoff
-	Piece piece_num[13]; // the number of pieces to help index the piece lists
-	Piece piece_list[13][10]; // Piece lists to speed up move generation
+	Bitboard by_type[7]; // Bitboard of the pieces of each type for both sides
+	Bitboard by_color[2]; // Bitboard of all pieces for white and black
+	Key pos_key; // Zobrist key of the current position, updated incrementally
+	Key pawn_key; // Zobrist key of the pawns only, used by the pawn hash table
+	int16_t material[2]; // Material count for both black and white players
+	int16_t psq[PHASE_NB][2]; // Midgame and endgame piece square totals for both players
+	int16_t phase; // Game phase from the remaining pieces, MAX_PHASE in the opening
+	int16_t rule50; // Halfmoves since the last capture or pawn advance (50 move draw)
+	int16_t game_ply; // total ply since the start of the game
+	int16_t start_ply; // game ply the position was set up at, the history has nothing before it
+	Byte to_move; // side to move
 	Byte castling_perms; // Byte which holds castling permissions for current position
-	Square en_passant_target; // En-Passant target square if it exists
-	Color to_move; // side to move
-	int rule50; // Halfmoves since the last capture or pawn advance (50 move draw)
-	int game_ply; // total ply since the start of the game
-	Value mobility[2]; // mobility score for white and black
-	Snapshot history_stack[MAX_GAME_MOVES]; // History stack used to undo moves
-	Key pos_key; // Key of the previous position to modify
-
-	Position();
-	Position(const string fen);
+	int8_t en_passant_target; // En-Passant target square if it exists
+	int8_t piece_num[13]; // the number of pieces to help index the piece lists
+	int8_t board[120]; // Board array
+	int8_t piece_list[13][10]; // Piece lists to speed up move generation
+	Snapshot* history; // History stack of the game used to undo moves, see GameHistory
+
+	Position(GameHistory* game = NULL);
+	Position(const string fen, GameHistory* game);
 	static void init();
 	void print_board();
 	void parse_fen(const string& fen);
 	void make_move(Move m, bool save = true);
 	void undo_move();
+	void make_null_move();
+	void undo_null_move();
+	void set_history(GameHistory* game);
 	Piece piece_at(Square s);
+	Bitboard pieces(PieceType ptype) const { return by_type[ptype]; }
+	Bitboard side_pieces(Color side) const { return by_color[side]; }
+	Bitboard pieces(Color side, PieceType ptype) const { return by_color[side] & by_type[ptype]; }
+	Bitboard occupied() const { return by_color[WHITE] | by_color[BLACK]; }
 	Key generate_position_key();
 
 private:
@@ -44,10 +64,13 @@ private:
 	void add_piece(Square s, Piece p);
 	void remove_piece(Square s, Piece p);
 	void handle_en_passant(Piece p, Move m);
-	void parse_castling(Piece p, Move m);
+	void parse_castling(Piece p, Move m, Piece captured);
 	void do_castling(Move m);
 	void undo_castling(Move m);
-	void take_snapshot(Move m);
+	void take_snapshot(Move m, Piece captured);
+#ifdef KEY_CHECK
+	void check_key();
+#endif
 
 };
 
@@ -92,6 +115,31 @@ inline PieceType type_of(Piece p) {
 	return piece_type[p];
 }
 
+// Create a move from 120 based squares
+inline Move create_move(Square from, Square to, int type = NORMAL, PieceType promotion = KNIGHT) {
+	return Move(to64(from) | (to64(to) << 6) | ((promotion - KNIGHT) << 12) | type);
+}
+
+// Get the 120 based from square of a move
+inline Square from_sq(Move m) {
+	return sq64_to_120[m & 63];
+}
+
+// Get the 120 based to square of a move
+inline Square to_sq(Move m) {
+	return sq64_to_120[(m >> 6) & 63];
+}
+
+// Get the type of a move, NORMAL, PROMOTION, EN_PASSANT or CASTLING
+inline int move_type(Move m) {
+	return m & (3 << 14);
+}
+
+// Get the piece type a pawn promotes to, only meaningful for promotions
+inline PieceType promotion_type(Move m) {
+	return KNIGHT + ((m >> 12) & 3);
+}
+
 // Set a bit to zero (for disabling castling perms)
 inline void clear_bit(Byte& i, int bit) {
 	i &= ~(bit);
@@ -1,65 +1,364 @@
+#include <algorithm>
+#include <cmath>
 #include <cstring>
+#include <iomanip>
 #include <iostream>
+#include <thread>
+#include <vector>
 
 #include "search.h"
 #include "evaluate.h"
 #include "attack.h"
 #include "movegen.h"
+#include "pawns.h"
+#include "tt.h"
+#include "movepick.h"
+#include "timeman.h"
 
-// Principal variation line
-MoveList main_pv_line = {};
-MoveList confirmed_best_line = {};
+// Search threads, threads[0] is the main thread
+vector<SearchThread*> threads;
 
-int num_ab = 0, num_q = 0;
+// Effective branching factor of the last iteration the main thread completed, the
+// stats command reads it from the UCI thread while the search runs
+atomic<double> branching_factor(0);
 
-void check_up(SearchInfo& info) {
-	if (info.timed_search && get_time() > info.stop_time) {
+// Half width of the first aspiration window in centipawns
+const Value ASPIRATION_WINDOW = 25;
+
+// Pruning margins in centipawns: delta pruning in quiescence, and futility pruning and
+// razoring per ply of remaining depth in alpha_beta()
+const Value DELTA_MARGIN = 200;
+const Value FUTILITY_MARGIN = 150;
+const Value RAZOR_MARGIN = 300;
+
+// Late move reductions by remaining depth and move number, filled by Search::init()
+int reductions[MAX_DEPTH][MAX_POSITION_MOVES];
+
+// Helper threads skip some depths so they don't all search the same iteration at the same time
+const int skip_size[20] = { 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 4, 4, 4, 4, 4, 4, 4, 4 };
+const int skip_phase[20] = { 0, 1, 0, 1, 2, 3, 0, 1, 2, 3, 4, 5, 0, 1, 2, 3, 4, 5, 6, 7 };
+
+namespace Search {
+
+	// init() builds the late move reduction table, reductions grow with the log of
+	// both the depth and the number of moves already searched
+	void init() {
+
+		for (int depth = 1; depth < MAX_DEPTH; depth++)
+			for (int moves = 1; moves < MAX_POSITION_MOVES; moves++)
+				reductions[depth][moves] = int(0.75 + log(depth) * log(moves) / 2.25);
+	}
+
+};
+
+// set_threads() creates the requested number of search threads
+void set_threads(int count) {
+
+	while ((int)threads.size() > count) {
+		delete threads.back();
+		threads.pop_back();
+	}
+
+	while ((int)threads.size() < count) {
+		SearchThread* thread = new SearchThread();
+		thread->id = threads.size();
+		threads.push_back(thread);
+	}
+}
+
+// clear_search_data() forgets the killers, history and pawn structures of every thread, for a new game
+void clear_search_data() {
+
+	for (size_t i = 0; i < threads.size(); i++) {
+		memset(&threads[i]->sd, 0, sizeof(SearchData));
+		clear_pawn_table(threads[i]->pawns);
+	}
+
+	clear_pawn_table(pawn_hash);
+}
+
+// update_history() moves a history score towards the bonus, the closer the score already
+// is to MAX_HISTORY the smaller the change, so scores never leave the range
+inline void update_history(int& entry, int bonus) {
+	entry += bonus - entry * abs(bonus) / MAX_HISTORY;
+}
+
+// total_nodes() returns the nodes searched by all threads
+long total_nodes() {
+
+	long nodes = 0;
+
+	for (size_t i = 0; i < threads.size(); i++)
+		nodes += threads[i]->nodes;
+
+	return nodes;
+}
+
+// collect_stats() adds up the statistics of all threads
+SearchStats collect_stats() {
+
+	SearchStats total = {};
+
+	for (size_t i = 0; i < threads.size(); i++) {
+		const SearchStats& s = threads[i]->stats;
+
+		total.main_nodes += s.main_nodes;
+		total.q_nodes += s.q_nodes;
+		total.cutoffs += s.cutoffs;
+		total.first_move_cutoffs += s.first_move_cutoffs;
+		total.cutoff_index_sum += s.cutoff_index_sum;
+		total.tt_probes += s.tt_probes;
+		total.tt_hits += s.tt_hits;
+		total.pawn_probes += threads[i]->pawns.probes;
+		total.pawn_hits += threads[i]->pawns.hits;
+	}
+
+	return total;
+}
+
+// percent() returns part of total in percent, 0 if total is 0
+inline double percent(U64 part, U64 total) {
+	return total ? 100.0 * part / total : 0.0;
+}
+
+// print_stats() prints the statistics of the current or last search as an info string
+void print_stats() {
+
+	SearchStats s = collect_stats();
+	U64 nodes = s.main_nodes + s.q_nodes;
+
+	cout << fixed << setprecision(2)
+	     << "info string nodes " << s.main_nodes << " qnodes " << s.q_nodes << " (" << percent(s.q_nodes, nodes) << "%)"
+	     << " ebf " << branching_factor.load(memory_order_relaxed)
+	     << " first cutoff " << percent(s.first_move_cutoffs, s.cutoffs) << "%"
+	     << " cutoff index " << (s.cutoffs ? double(s.cutoff_index_sum) / s.cutoffs : 0.0)
+	     << " tt hits " << percent(s.tt_hits, s.tt_probes) << "%"
+	     << " pawn hits " << percent(s.pawn_hits, s.pawn_probes) << "%" << endl;
+
+	cout.unsetf(ios::floatfield);
+	cout << setprecision(6);
+}
+
+// Only the main thread checks the clock, the helpers stop when it sets info.stopped.
+// The first iteration always finishes so there is a move to play.
+void check_up(SearchThread& thread, SearchInfo& info) {
+	if (thread.id == 0 && info.timed_search && thread.completed_depth
+		&& get_time() - info.start_time > info.maximum_time) {
 		info.stopped = true;
 	}
 }
 
+// search_position() gives every thread its own copy of the position and its history,
+// then runs the main thread and the helpers on the same root until the search ends.
+// The best move is taken from the thread which completed the deepest iteration.
 void search_position(Position& pos, SearchInfo& info) {
 
-	Value score;
-	Move best_move;
+	if (threads.empty())
+		set_threads(1);
+
+	info.root_ply = pos.game_ply;
+	branching_factor = 0;
+	TT.new_search();
+
+	for (size_t i = 0; i < threads.size(); i++) {
+		SearchThread& thread = *threads[i];
+
+		thread.pos = pos;
+		thread.pos.set_history(&thread.history);
+		memcpy(thread.history.stack, pos.history, pos.game_ply * sizeof(Snapshot));
+
+		// Killers are only good for the position they were found in. History is kept
+		// from the last search, but aged so the new search can change it quickly.
+		memset(thread.sd.killers, 0, sizeof(thread.sd.killers));
+		for (Color side = WHITE; side <= BLACK; side++)
+			for (Square from = 0; from < 64; from++)
+				for (Square to = 0; to < 64; to++)
+					thread.sd.history[side][from][to] /= 2;
+
+		thread.stats = SearchStats();
+		thread.null_min_ply = 0;
+		thread.root_depth = 0;
+		thread.pawns.probes = thread.pawns.hits = 0;
+		thread.pv.count = 0;
+		thread.completed_depth = 0;
+		thread.score = -INFINITE_VALUE;
+		thread.nodes = 0;
+	}
+
+	vector<std::thread> helpers;
+
+	for (size_t i = 1; i < threads.size(); i++)
+		helpers.push_back(std::thread(iterative_deepening, std::ref(*threads[i]), std::ref(info)));
+
+	iterative_deepening(*threads[0], info);
+
+	// The main thread is done, stop the helpers
+	info.stopped = true;
+
+	for (size_t i = 0; i < helpers.size(); i++)
+		helpers[i].join();
+
+	SearchThread* best = threads[0];
+
+	for (size_t i = 0; i < threads.size(); i++) {
+		SearchThread* thread = threads[i];
+
+		if (thread->pv.count && (thread->completed_depth > best->completed_depth
+			|| (thread->completed_depth == best->completed_depth && thread->score > best->score)))
+			best = thread;
+	}
+
+	if (info.silent)
+		return;
+
+	cout << "bestmove " << print_move(best->pv.moves[0]) << endl;
+}
+
+// print_info() prints the info line of an iteration, bound tells if the score is only
+// a lowerbound or an upperbound because it fell outside of the aspiration window
+void print_info(SearchInfo& info, int depth, Value score, const char* bound, Move* pv, int pv_count) {
+
+	long nodes = total_nodes();
+	int elapsed = get_time() - info.start_time;
+
+	cout << "info score cp " << score << bound << " depth " << depth << " nodes " << nodes << " nps " << nodes * 1000 / max(elapsed, 1)
+	     << " time " << elapsed << " hashfull " << TT.hashfull() << " pv ";
+
+	for (int i = 0; i < pv_count; i++)
+		cout << print_move(pv[i]) << " ";
+	cout << endl;
+}
+
+// iterative_deepening() searches the root one depth deeper at a time. From depth 5 on
+// the search starts with a narrow aspiration window around the score of the last
+// iteration, which is widened on the failing side until the score falls inside it.
+void iterative_deepening(SearchThread& thread, SearchInfo& info) {
+
+	Value score = 0;
+	long last_nodes = 0, last_iteration_nodes = 0;
 
 	for (int i = 1; i <= info.depth; i++) {
-		num_ab = 0;
-		num_q = 0;
 
-		// perform the search
-		score = alpha_beta(pos, info, &main_pv_line, i, -INFINITE_VALUE, INFINITE_VALUE);
+		if (thread.id > 0) {
+			int n = (thread.id - 1) % 20;
+			if (((i + info.root_ply + skip_phase[n]) / skip_size[n]) % 2)
+				continue;
+		}
+
+		Value delta = ASPIRATION_WINDOW;
+		Value alpha = -INFINITE_VALUE, beta = INFINITE_VALUE;
+
+		thread.root_depth = i;
+
+		if (thread.completed_depth >= 4 && abs(thread.score) < MATE_IN_MAX) {
+			alpha = max(thread.score - delta, -INFINITE_VALUE);
+			beta = min(thread.score + delta, int(INFINITE_VALUE));
+		}
+
+		while (true) {
+
+			// perform the search
+			score = alpha_beta(thread, info, PV, i, alpha, beta);
+
+			if (info.stopped)
+				break;
+
+			// Fail low, the PV is empty so the last one is shown
+			if (score <= alpha) {
+				if (thread.id == 0 && !info.silent)
+					print_info(info, i, score, " upperbound", thread.pv.moves, thread.pv.count);
+
+				if (thread.id == 0)
+					Time.fail_low(info);
+
+				beta = (alpha + beta) / 2;
+				alpha = max(score - delta, -INFINITE_VALUE);
+			}
+			// Fail high, the PV starts with the move which failed high
+			else if (score >= beta) {
+				if (thread.id == 0 && !info.silent)
+					print_info(info, i, score, " lowerbound", thread.pv_table[0], thread.pv_length[0]);
+
+				beta = min(score + delta, int(INFINITE_VALUE));
+			}
+			else
+				break;
+
+			delta += delta / 2;
+		}
 
 		if (info.stopped) {
 			break;
 		}
 
-		confirmed_best_line = main_pv_line;
+		thread.pv.count = thread.pv_length[0];
+		memcpy(thread.pv.moves, thread.pv_table[0], thread.pv.count * sizeof(Move));
+		thread.completed_depth = i;
+		thread.score = score;
 
-		// print search results for current dept
-		cout << "info score cp " << score << " depth " << i << " nodes " << info.nodes << " time " << get_time() - info.start_time << " pv ";
-		print_move_list(main_pv_line);
-	}
+		if (thread.id != 0)
+			continue;
 
-	best_move = confirmed_best_line.moves[0];
-	cout << "bestmove " << print_move(best_move) << endl;
+		// Nodes of this iteration over the nodes of the last one. Only the main thread's
+		// own nodes count, the helpers skip depths and would distort the ratio.
+		long nodes = thread.nodes;
+		long iteration_nodes = nodes - last_nodes;
+		double ebf = last_iteration_nodes ? double(iteration_nodes) / last_iteration_nodes : 0;
+		branching_factor.store(ebf, memory_order_relaxed);
+		last_nodes = nodes;
+		last_iteration_nodes = iteration_nodes;
+
+		if (!info.silent) {
+			print_info(info, i, score, "", thread.pv.moves, thread.pv.count);
+			print_stats();
+		}
+
+		if (info.timed_search && Time.stop_after_iteration(info, thread.pv.moves[0], score, ebf))
+			break;
+	}
 }
 
 // Quiescence makes sure that there are no cheeky captures at the end of the search
-Value Quiescence(Position& pos, SearchInfo& info, Value alpha, Value beta) {
-	
-	if (info.nodes % 2048 == 0)
-		check_up(info);
+Value Quiescence(SearchThread& thread, SearchInfo& info, Value alpha, Value beta) {
+
+	Position& pos = thread.pos;
 
-	info.nodes++;
+	if (thread.nodes % 2048 == 0)
+		check_up(thread, info);
+
+	thread.nodes++;
+	thread.stats.q_nodes++;
+
+	int ply = pos.game_ply - info.root_ply;
+
+	thread.pv_length[ply] = 0;
 
 	if (is_repetition(pos) || pos.rule50 >= 100)
 		return 0;
 
-	if (pos.game_ply > MAX_DEPTH - 1)
-		return evaluate(pos);
+	if (ply >= MAX_DEPTH - 1)
+		return evaluate(pos, thread.pawns);
+
+	// Any stored result is at least as deep as a quiescence search
+	TTData ttd;
+	bool found = TT.probe(pos.pos_key, ttd);
+
+	thread.stats.tt_probes++;
+	thread.stats.tt_hits += found;
+	Move hash_move = found ? ttd.move : MOVE_NONE;
 
-	Value current_eval = evaluate(pos);
+	if (found) {
+		Value tt_score = value_from_tt(ttd.score, ply);
+
+		if (ttd.bound == BOUND_EXACT
+			|| (ttd.bound == BOUND_LOWER && tt_score >= beta)
+			|| (ttd.bound == BOUND_UPPER && tt_score <= alpha))
+			return max(alpha, min(tt_score, beta));
+	}
+
+	Value current_eval = evaluate(pos, thread.pawns);
+	Value old_alpha = alpha;
+	Move best_move = MOVE_NONE;
 
 	if (current_eval >= beta) {
 		return beta;
@@ -69,123 +368,292 @@ Value Quiescence(Position& pos, SearchInfo& info, Value alpha, Value beta) {
 		alpha = current_eval;
 	}
 
-	MoveList captures = {};
-	get_psuedo_legal_captures(pos, captures);
-	sort_moves(captures);
+	// Delta pruning, skip captures which can't bring the score back up to alpha even with
+	// a margin for the positional gain. Not in check or when looking for a mate.
+	bool checked = in_check(pos);
+	bool delta_pruning = !checked && abs(alpha) < MATE_IN_MAX;
+
+	// Not even winning a queen would be enough
+	if (delta_pruning && current_eval + value_of(QUEEN) + DELTA_MARGIN < alpha)
+		return alpha;
+
+	Value stand_pat = current_eval;
+
+	MovePicker picker(pos, thread.move_stack[ply], hash_move);
+	Move capture;
 
 	current_eval = -INFINITE_VALUE;
-	//int legal_moves = 0;
 
-	for (int index = 0; index < captures.count; index++) {
+	while (picker.next_move(capture)) {
 
-		Move capture = captures.moves[index];
+		if (delta_pruning && move_type(capture) != PROMOTION) {
+			Piece victim = pos.piece_at(to_sq(capture));
+			Value gain = (victim == NO_PIECE) ? value_of(PAWN) : value_of(type_of(victim)); // en-passant
 
-		if (!is_legal_move(pos, capture)) {
-			continue;
+			if (stand_pat + gain + DELTA_MARGIN <= alpha)
+				continue;
 		}
 
+		// Captures which lose material in the exchange are very unlikely to raise alpha
+		if (!checked && move_type(capture) != PROMOTION && see(pos, capture) < 0)
+			continue;
+
 		pos.make_move(capture);
-		current_eval = -Quiescence(pos, info, -beta, -alpha);
+		current_eval = -Quiescence(thread, info, -beta, -alpha);
 		pos.undo_move();
 
 		if (info.stopped)
 			return 0;
 
 		if (current_eval >= beta) {
+			TT.store(pos.pos_key, value_to_tt(beta, ply), BOUND_LOWER, 0, capture);
 			return beta;
 		}
 		if (current_eval > alpha) {
 			alpha = current_eval;
+			best_move = capture;
 		}
 	}
 
+	TT.store(pos.pos_key, value_to_tt(alpha, ply), (alpha > old_alpha) ? BOUND_EXACT : BOUND_UPPER, 0, best_move);
+
 	return alpha;
 }
 
-// Alpha Beta is the main search algorithm for determening the best move
-Value alpha_beta(Position& pos, SearchInfo& info, MoveList* pvline, int depth, Value alpha, Value beta) {
+// Alpha Beta is the main search algorithm for determening the best move. It is a principal
+// variation search: the first move of a PV node gets the full window and the other moves a
+// null window, which is only opened again if they turn out to be better. Late quiet moves
+// are searched to a reduced depth first.
+Value alpha_beta(SearchThread& thread, SearchInfo& info, NodeType node, int depth, Value alpha, Value beta) {
 
-	MoveList temp_pv_line = {};
+	Position& pos = thread.pos;
+	SearchData& sd = thread.sd;
 
 	// If we are at a leaf node, evaluate the position
-	if (depth == 0) {
-		pvline->count = 0;
-		//return evaluate(pos);
-		return Quiescence(pos, info, alpha, beta);
+	if (depth <= 0) {
+		//return evaluate(pos, thread.pawns);
+		return Quiescence(thread, info, alpha, beta);
 	}
 
-	if (info.nodes % 2048 == 0)
-		check_up(info);
+	if (thread.nodes % 2048 == 0)
+		check_up(thread, info);
+
+	thread.nodes++;
+	thread.stats.main_nodes++;
 
-	info.nodes++;
+	int ply = pos.game_ply - info.root_ply;
 
-	if ((is_repetition(pos) || pos.rule50 >= 100) && pos.game_ply) {
+	thread.pv_length[ply] = 0;
+
+	if ((is_repetition(pos) || pos.rule50 >= 100) && ply) {
 		return 0;
 	}
 
-	if (pos.game_ply > MAX_GAME_MOVES - 1) {
-		return evaluate(pos);
+	if (ply >= MAX_DEPTH - 1) {
+		return evaluate(pos, thread.pawns);
+	}
+
+	// Mate distance pruning, even mating on the next move can't beat a shorter mate
+	// found already, and being mated here is no worse than alpha
+	if (ply) {
+		alpha = max(alpha, MATED + ply);
+		beta = min(beta, MATE - ply - 1);
+
+		if (alpha >= beta)
+			return alpha;
+	}
+
+	bool pv_node = (node == PV);
+
+	// Use the stored result in non PV nodes if it was searched deep enough.
+	// The root is a PV node, so it always searches to get a move.
+	TTData ttd;
+	bool found = TT.probe(pos.pos_key, ttd);
+
+	thread.stats.tt_probes++;
+	thread.stats.tt_hits += found;
+	Move hash_move = found ? ttd.move : MOVE_NONE;
+
+	if (found && !pv_node && ttd.depth >= depth) {
+		Value tt_score = value_from_tt(ttd.score, ply);
+
+		if (ttd.bound == BOUND_EXACT
+			|| (ttd.bound == BOUND_LOWER && tt_score >= beta)
+			|| (ttd.bound == BOUND_UPPER && tt_score <= alpha))
+			return max(alpha, min(tt_score, beta));
+	}
+
+	bool checked = in_check(pos);
+	Value static_eval = checked ? -INFINITE_VALUE : evaluate(pos, thread.pawns);
+	bool near_mate = abs(alpha) >= MATE_IN_MAX || abs(beta) >= MATE_IN_MAX;
+
+	// Razoring, when the static eval is far below alpha close to the leaves, a quiescence
+	// search decides if any capture can save the node
+	if (!pv_node && !checked && !near_mate && depth <= 2 && static_eval + RAZOR_MARGIN * depth <= alpha) {
+		Value razor_score = Quiescence(thread, info, alpha, beta);
+
+		if (razor_score <= alpha)
+			return alpha;
+	}
+
+	// Null move pruning, if we are still above beta after passing the turn to the opponent
+	// then a real move will almost certainly be too. Not in check, in PV nodes or right after
+	// another null move, and not without pieces, where passing might be the only good move.
+	Bitboard pieces = pos.side_pieces(pos.to_move) & ~pos.pieces(PAWN) & ~pos.pieces(KING);
+
+	if (!pv_node && !checked && depth >= 3 && ply >= thread.null_min_ply && pieces
+		&& pos.history[pos.game_ply - 1].move != MOVE_NONE && !near_mate
+		&& static_eval >= beta) {
+
+		int R = 3 + depth / 6;
+
+		pos.make_null_move();
+		Value null_score = -alpha_beta(thread, info, NON_PV, depth - 1 - R, -beta, -beta + 1);
+		pos.undo_null_move();
+
+		if (info.stopped)
+			return 0;
+
+		if (null_score >= beta) {
+
+			if (depth < 10)
+				return beta;
+
+			// At high depth verify the cutoff with a reduced search without null moves
+			// for the next plies, this catches zugzwang positions with pieces on the board
+			int old_min_ply = thread.null_min_ply;
+			thread.null_min_ply = ply + 3 * (depth - R) / 4;
+			Value verified = alpha_beta(thread, info, NON_PV, depth - R, beta - 1, beta);
+			thread.null_min_ply = old_min_ply;
+
+			if (verified >= beta)
+				return beta;
+		}
 	}
 
-	MoveList mlist = {};
-	get_psuedo_legals(pos, mlist);
-	sort_moves(mlist);
+	MovePicker picker(pos, thread.move_stack[ply], sd, hash_move, ply);
 	Move move;
 	Value eval = -INFINITE_VALUE;
+	Value old_alpha = alpha;
+	Move best_move = MOVE_NONE;
 	int legal_moves = 0;
+	Move quiets_tried[MAX_POSITION_MOVES];
+	int quiet_count = 0;
+
+	// Futility pruning, near the leaves quiet moves can't raise a static eval this far
+	// below alpha. Moves which give check are still searched.
+	bool futile = !pv_node && !checked && !near_mate && depth <= 3
+		&& static_eval + FUTILITY_MARGIN * depth <= alpha;
 
-	for (int i = 0; i < mlist.count; i++) {
+	while (picker.next_move(move)) {
+
+		legal_moves++;
 
-		move = mlist.moves[i];
+		bool quiet = !is_capture(pos, move) && move_type(move) != PROMOTION;
+		bool check = gives_check(pos, move);
 
-		if (!is_legal_move(pos, move)) {
+		// Futile quiet moves are skipped before they are made
+		if (futile && quiet && legal_moves > 1 && !check)
 			continue;
+
+		pos.make_move(move);
+
+		// Extend checks so that checking sequences don't end in the quiescence search, which
+		// doesn't look at checks. Only up to twice the iteration depth, so they can't explode.
+		int new_depth = depth - 1 + (check && ply < 2 * thread.root_depth);
+
+		if (legal_moves == 1) {
+			eval = -alpha_beta(thread, info, node, new_depth, -beta, -alpha);
 		}
+		else {
+			// Reduce late quiet moves, but not killers, moves out of check or checking moves
+			int reduction = 0;
 
-		legal_moves++;
+			if (depth >= 3 && quiet && !checked && !check
+				&& move != sd.killers[ply][0] && move != sd.killers[ply][1]) {
+				reduction = reductions[min(depth, MAX_DEPTH - 1)][min(legal_moves, MAX_POSITION_MOVES - 1)] - pv_node;
+				reduction = max(0, min(reduction, depth - 2));
+			}
+
+			eval = -alpha_beta(thread, info, NON_PV, new_depth - reduction, -alpha - 1, -alpha);
+
+			// The reduced search beat alpha, verify it at full depth
+			if (eval > alpha && reduction)
+				eval = -alpha_beta(thread, info, NON_PV, new_depth, -alpha - 1, -alpha);
+
+			// The move may become the new PV, search it again with the full window
+			if (eval > alpha && eval < beta && pv_node)
+				eval = -alpha_beta(thread, info, PV, new_depth, -beta, -alpha);
+		}
 
-		pos.make_move(move);
-		eval = -alpha_beta(pos, info, &temp_pv_line, depth - 1, -beta, -alpha);
 		pos.undo_move();
 
 		if (info.stopped)
 			return 0;
 
-		if (eval >= beta)
-			return beta;
-
 		if (eval > alpha) {
 
-			// store in hueristic array
-			pos.cutoff_moves[move.from][move.to] += depth;
+			// The PV of this ply is the move followed by the PV of the ply below.
+			// It is kept on a beta cutoff too, so a root fail high can show its move.
+			thread.pv_table[ply][0] = move;
+			memcpy(thread.pv_table[ply] + 1, thread.pv_table[ply + 1], thread.pv_length[ply + 1] * sizeof(Move));
+			thread.pv_length[ply] = thread.pv_length[ply + 1] + 1;
+
+			if (eval >= beta) {
+
+				thread.stats.cutoffs++;
+				thread.stats.first_move_cutoffs += (legal_moves == 1);
+				thread.stats.cutoff_index_sum += legal_moves - 1;
+
+				// Remember quiet moves which cut off as killers for this ply, and reward them in
+				// the history. The quiet moves tried before it failed, so they are punished.
+				if (quiet) {
+					int bonus = min(depth * depth, 1200);
+
+					if (sd.killers[ply][0] != move) {
+						sd.killers[ply][1] = sd.killers[ply][0];
+						sd.killers[ply][0] = move;
+					}
+
+					update_history(history_of(sd, pos.to_move, move), bonus);
+
+					for (int i = 0; i < quiet_count; i++)
+						update_history(history_of(sd, pos.to_move, quiets_tried[i]), -bonus);
+				}
+
+				TT.store(pos.pos_key, value_to_tt(beta, ply), BOUND_LOWER, depth, move);
+				return beta;
+			}
 
 			alpha = eval;
-			pvline->moves[0] = move;
-			memcpy(pvline->moves + 1, temp_pv_line.moves, temp_pv_line.count * sizeof(Move));
-			pvline->count = temp_pv_line.count + 1;
+			best_move = move;
 		}
-	}
 
-	bool checked = in_check(pos);
+		if (quiet)
+			quiets_tried[quiet_count++] = move;
+	}
 
 	// Checkmate and stalemate
 	if (legal_moves == 0) {
 		if (checked)
-			return MATED + pos.game_ply;
+			return MATED + ply;
 		else
 			return 0;
 	}
 
+	TT.store(pos.pos_key, value_to_tt(alpha, ply), (alpha > old_alpha) ? BOUND_EXACT : BOUND_UPPER, depth, best_move);
+
 	return alpha;
 }
 
 bool is_repetition(Position& pos) {
 
-	Key current = pos.generate_position_key();
+	Key current = pos.pos_key;
 	int repeated = 1;
 
-	for (int i = pos.game_ply - pos.rule50; i < pos.game_ply; i++) {
-		if (pos.history_stack[i].id == current)
+	// The snapshots before the position was set up were never written for this game
+	for (int i = max(pos.game_ply - pos.rule50, int(pos.start_ply)); i < pos.game_ply; i++) {
+		if (pos.history[i].id == current)
 			repeated++;
 
 		if (repeated >= 3)
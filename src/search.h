@@ -3,11 +3,74 @@
 
 #include "types.h"
 #include "position.h"
+#include "pawns.h"
 
-void check_up(SearchInfo& info);
+// PV nodes are searched with an open window and can change the principal variation,
+// every other node is searched with a null window and only has to fail high or low
+enum NodeType { PV, NON_PV };
+
+namespace Search {
+	void init();
+}
+
+// History scores stay within +-MAX_HISTORY
+const int MAX_HISTORY = 16384;
+
+// The SearchData structure holds the move ordering heuristics of a search thread
+struct SearchData {
+	int history[2][64][64]; // butterfly history of quiet moves by side, from and to square
+	Move killers[MAX_DEPTH][2]; // Quiet moves which caused a beta cutoff at each ply
+};
+
+// Returns the history score of a quiet move for the side
+inline int& history_of(SearchData& sd, Color side, Move m) {
+	return sd.history[side][m & 63][(m >> 6) & 63];
+}
+
+// The SearchStats structure counts what happened in a search, to see if move ordering and
+// pruning changes help. Every thread keeps its own counters, collect_stats() adds them up.
+struct SearchStats {
+	Counter main_nodes; // nodes of alpha_beta()
+	Counter q_nodes; // nodes of Quiescence()
+	Counter cutoffs; // beta cutoffs in alpha_beta()
+	Counter first_move_cutoffs; // beta cutoffs by the first move searched
+	Counter cutoff_index_sum; // sum of the move index of every cutoff, 0 for the first move
+	Counter tt_probes;
+	Counter tt_hits;
+	Counter pawn_probes;
+	Counter pawn_hits;
+};
+
+// The SearchThread structure holds everything owned by one thread of the Lazy SMP search.
+// Only the transposition table and the SearchInfo are shared between threads.
+struct SearchThread {
+	int id; // 0 is the main thread, which handles the time and the output
+	Position pos;
+	GameHistory history;
+	SearchData sd;
+	SearchStats stats;
+	PawnTable pawns;
+	MoveList move_stack[MAX_DEPTH]; // move list of each ply, the generators append to it in place
+	Move pv_table[MAX_DEPTH][MAX_DEPTH]; // triangular PV table, the line found from each ply
+	int pv_length[MAX_DEPTH];
+	int null_min_ply; // no null moves before this ply while a null move cutoff is verified
+	int root_depth; // depth of the iteration being searched, bounds the check extensions
+	PVLine pv; // principal variation of the last completed iteration
+	int completed_depth;
+	Value score;
+	Counter nodes; // read by the main thread for the info output and the node count
+};
+
+void set_threads(int count);
+void clear_search_data();
+long total_nodes();
+SearchStats collect_stats();
+void print_stats();
+void check_up(SearchThread& thread, SearchInfo& info);
 void search_position(Position& pos, SearchInfo& info);
-Value alpha_beta(Position& pos, SearchInfo& info, MoveList* pvline, int depth, Value alpha, Value beta);
-Value Quiescence(Position& pos, SearchInfo& info, Value alpha, Value beta);
+void iterative_deepening(SearchThread& thread, SearchInfo& info);
+Value alpha_beta(SearchThread& thread, SearchInfo& info, NodeType node, int depth, Value alpha, Value beta);
+Value Quiescence(SearchThread& thread, SearchInfo& info, Value alpha, Value beta);
 bool is_repetition(Position& pos);
 
 #endif
\ No newline at end of file
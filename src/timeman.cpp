@@ -0,0 +1,88 @@
+#include <algorithm>
+
+#include "timeman.h"
+
+// Moves the remaining time is spread over when the GUI doesn't send movestogo
+const int DEFAULT_MOVES_TO_GO = 40;
+
+TimeManager Time;
+
+TimeManager::TimeManager() {
+	move_overhead = 30;
+}
+
+// TimeManager::init() sets the optimum and maximum time of a search from the clock.
+// The remaining time and the increments of the moves to go are shared out evenly, after
+// taking off the move overhead. A single move never uses more than 80% of
+// the clock, so a fixed movetime is the only case where both limits are the same.
+void TimeManager::init(SearchInfo& info, int time, int inc, int movestogo, int movetime) {
+
+	last_best_move = MOVE_NONE;
+	last_score = 0;
+	stable_iterations = 0;
+	last_iteration_end = 0;
+	extended = false;
+
+	info.timed_search = (time != -1 || movetime != -1);
+
+	if (movetime != -1) {
+		info.optimum_time = info.maximum_time = max(movetime - move_overhead, 1);
+		return;
+	}
+
+	if (time == -1)
+		return;
+
+	int moves = movestogo ? min(movestogo, 50) : DEFAULT_MOVES_TO_GO;
+	int available = max(time + inc * (moves - 1) - move_overhead, 1);
+
+	info.maximum_time = max(min(available / moves * 5, time * 8 / 10 - move_overhead), 1);
+	info.optimum_time = min(available / moves, info.maximum_time);
+}
+
+// TimeManager::stop_after_iteration() is called by the main thread after every completed
+// iteration of a timed search and returns true if it should not start another one.
+// A best move which has not changed for a few iterations shortens the optimum time and a
+// falling score makes it longer. The next iteration is skipped if it would probably not
+// finish before the maximum time, its length is guessed from the last one and the
+// branching factor.
+bool TimeManager::stop_after_iteration(SearchInfo& info, Move best_move, Value score, double branching_factor) {
+
+	int elapsed = get_time() - info.start_time;
+	int iteration_time = elapsed - last_iteration_end;
+	double scale = 1.0;
+
+	stable_iterations = (best_move == last_best_move) ? stable_iterations + 1 : 0;
+
+	if (stable_iterations >= 3)
+		scale = 0.5;
+	else if (stable_iterations == 0 && last_best_move != MOVE_NONE)
+		scale = 1.3;
+
+	// The score fell since the last iteration, take longer to look for a way out
+	if (last_best_move != MOVE_NONE && score < last_score - 30)
+		scale *= 2.0;
+
+	last_best_move = best_move;
+	last_score = score;
+	last_iteration_end = elapsed;
+	extended = false;
+
+	if (elapsed >= min(int(info.optimum_time * scale), info.maximum_time))
+		return true;
+
+	return elapsed + iteration_time * max(branching_factor, 2.0) > info.maximum_time;
+}
+
+// TimeManager::fail_low() is called by the main thread when the root score falls below the
+// aspiration window. The best move is in doubt, so the optimum time is made longer straight
+// away instead of waiting for the iteration to finish. Only once per iteration, and never
+// beyond the maximum time.
+void TimeManager::fail_low(SearchInfo& info) {
+
+	if (!info.timed_search || extended)
+		return;
+
+	extended = true;
+	info.optimum_time = min(info.optimum_time * 2, info.maximum_time);
+}
@@ -0,0 +1,28 @@
+#ifndef __TIMEMAN_H__
+#define __TIMEMAN_H__
+
+#include "types.h"
+
+// The TimeManager class decides how long the main thread searches. The optimum time is
+// what a move should normally take, the search never goes beyond the maximum time.
+class TimeManager {
+
+public:
+	int move_overhead; // milliseconds lost per move to the GUI and the network, a UCI option
+
+	TimeManager();
+	void init(SearchInfo& info, int time, int inc, int movestogo, int movetime);
+	bool stop_after_iteration(SearchInfo& info, Move best_move, Value score, double branching_factor);
+	void fail_low(SearchInfo& info);
+
+private:
+	Move last_best_move;
+	Value last_score;
+	int stable_iterations; // iterations in a row which kept the best move
+	int last_iteration_end;
+	bool extended; // the optimum time was already extended for a fail low in this iteration
+};
+
+extern TimeManager Time;
+
+#endif // !__TIMEMAN_H__
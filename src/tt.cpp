@@ -0,0 +1,124 @@
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#include "tt.h"
+#include "position.h"
+
+const size_t DEFAULT_HASH_MB = 16;
+
+TranspositionTable TT;
+
+TranspositionTable::TranspositionTable() {
+	table = NULL;
+	memory = NULL;
+	cluster_count = 0;
+	generation = 0;
+	resize(DEFAULT_HASH_MB);
+}
+
+TranspositionTable::~TranspositionTable() {
+	free(memory);
+}
+
+// TranspositionTable::resize() allocates the largest power of two number of clusters that fits in the size
+void TranspositionTable::resize(size_t mb) {
+
+	size_t clusters = mb * 1024 * 1024 / sizeof(TTCluster);
+
+	cluster_count = 1;
+	while (cluster_count * 2 <= clusters)
+		cluster_count *= 2;
+
+	free(memory);
+	memory = malloc(cluster_count * sizeof(TTCluster) + 63);
+
+	if (!memory) {
+		cerr << "Failed to allocate " << mb << "MB for the transposition table" << endl;
+		exit(EXIT_FAILURE);
+	}
+
+	// Align the table to a cache line
+	table = (TTCluster*)((uintptr_t(memory) + 63) & ~uintptr_t(63));
+	clear();
+}
+
+void TranspositionTable::clear() {
+	memset(table, 0, cluster_count * sizeof(TTCluster));
+	generation = 0;
+}
+
+// TranspositionTable::new_search() ages the table so old entries get replaced first
+void TranspositionTable::new_search() {
+	generation = (generation + 1) & 63;
+}
+
+// TranspositionTable::probe() copies out the entry for the position if it is in the table
+bool TranspositionTable::probe(Key key, TTData& ttd) {
+
+	TTEntry* tte = table[key & (cluster_count - 1)].entry;
+
+	for (int i = 0; i < CLUSTER_SIZE; i++) {
+
+		// Read the data once, so the key check and the values we return agree
+		U64 data = tte[i].data;
+
+		if ((tte[i].key ^ data) == key && data) {
+			TTEntry entry = { key, data };
+			ttd.score = entry.score();
+			ttd.move = entry.move();
+			ttd.depth = entry.depth();
+			ttd.bound = entry.bound();
+			return ttd.bound != BOUND_NONE;
+		}
+	}
+
+	return false;
+}
+
+// TranspositionTable::store() writes a search result into the cluster of the position.
+// It overwrites the entry of the same position, an empty one, or the shallowest and oldest one.
+void TranspositionTable::store(Key key, Value score, Byte bound, int depth, Move move) {
+
+	TTEntry* tte = table[key & (cluster_count - 1)].entry;
+	TTEntry* replace = tte;
+
+	for (int i = 0; i < CLUSTER_SIZE; i++) {
+
+		if ((tte[i].key ^ tte[i].data) == key || !tte[i].data) {
+			replace = &tte[i];
+			break;
+		}
+
+		int age = (64 + generation - tte[i].generation()) & 63;
+		int replace_age = (64 + generation - replace->generation()) & 63;
+
+		if (tte[i].depth() - 8 * age < replace->depth() - 8 * replace_age)
+			replace = &tte[i];
+	}
+
+	// Keep the old hash move if we have no better one for the same position
+	if (!move && (replace->key ^ replace->data) == key)
+		move = replace->move();
+
+	U64 data = TTEntry::pack(score, move, depth, (generation << 2) | bound);
+	replace->data = data;
+	replace->key = key ^ data;
+}
+
+// TranspositionTable::hashfull() returns how full the table is in permill, sampled from the first 1000 entries
+int TranspositionTable::hashfull() {
+
+	int count = 0;
+
+	for (int i = 0; i < 1000 / CLUSTER_SIZE; i++) {
+		for (int j = 0; j < CLUSTER_SIZE; j++) {
+			const TTEntry& tte = table[i].entry[j];
+			if (tte.data && tte.generation() == generation)
+				count++;
+		}
+	}
+
+	return count * 1000 / (1000 / CLUSTER_SIZE * CLUSTER_SIZE);
+}
@@ -0,0 +1,74 @@
+#ifndef __TT_H__
+#define __TT_H__
+
+#include <cstddef>
+#include "types.h"
+
+// Bound types of a stored score
+enum { BOUND_NONE, BOUND_UPPER, BOUND_LOWER, BOUND_EXACT };
+
+// The TTData structure is the decoded content of an entry, copied out of the table
+struct TTData {
+	Value score;     // score adjusted so mates are relative to this position
+	Move move;       // best move, MOVE_NONE if none
+	int depth;       // remaining depth the position was searched to
+	Byte bound;
+};
+
+// The TTEntry structure is 16 bytes: the data packed into one word, and the position key XORed
+// with that word. The table is shared by all search threads without locks, and an entry torn by
+// two threads writing at once no longer matches its key, so it is simply treated as a miss.
+struct TTEntry {
+	Key key;
+	U64 data; // score in bits 0-31, move in 32-47, depth in 48-55, generation and bound in 56-63
+
+	static U64 pack(Value score, Move move, int depth, Byte gen_bound) {
+		return U64(uint32_t(score)) | (U64(move) << 32) | (U64(Byte(depth)) << 48) | (U64(gen_bound) << 56);
+	}
+
+	Value score() const { return int32_t(uint32_t(data)); }
+	Move move() const { return Move(data >> 32); }
+	int depth() const { return int8_t(data >> 48); }
+	Byte bound() const { return (data >> 56) & 3; }
+	Byte generation() const { return data >> 58; }
+};
+
+const int CLUSTER_SIZE = 4;
+
+// Entries are grouped in clusters which fill exactly one cache line
+struct alignas(64) TTCluster {
+	TTEntry entry[CLUSTER_SIZE];
+};
+
+// The TranspositionTable class is a hash table of clusters indexed by the position key
+class TranspositionTable {
+
+public:
+	TranspositionTable();
+	~TranspositionTable();
+	void resize(size_t mb);
+	void clear();
+	void new_search();
+	bool probe(Key key, TTData& ttd);
+	void store(Key key, Value score, Byte bound, int depth, Move move);
+	int hashfull();
+
+private:
+	TTCluster* table;
+	void* memory; // unaligned allocation which table points into
+	size_t cluster_count;
+	Byte generation;
+};
+
+extern TranspositionTable TT;
+
+// Mate scores are stored relative to the position instead of the root
+inline Value value_to_tt(Value v, int ply) {
+	return (v >= MATE_IN_MAX) ? v + ply : (v <= -MATE_IN_MAX) ? v - ply : v;
+}
+
+inline Value value_from_tt(Value v, int ply) {
+	return (v >= MATE_IN_MAX) ? v - ply : (v <= -MATE_IN_MAX) ? v + ply : v;
+}
+
+#endif // !__TT_H__
@@ -1,15 +1,17 @@
 #ifndef __TYPES_H__
 #define __TYPES_H__
 
+#include <atomic>
 #include <cassert>
 #include <cctype>
+#include <cstdint>
 #include <string>
 
 using namespace std;
 
 typedef int Square, Color, File, Rank, Piece, PieceType, Moves, MoveScore, Value;
 typedef unsigned char Byte;
-typedef unsigned long long Key, U64;
+typedef unsigned long long Key, U64, Bitboard;
 
 const string NAME = "Quokka 2.1";
 const string AUTHOR = "Matt P";
@@ -20,6 +22,7 @@ const int MAX_DEPTH = 64;
 const int INFINITE_VALUE = 100000; // a theoretical "infinite" to value the king
 const int MATED = -INFINITE_VALUE + 100; // this value has to be larger than -infinity so we know the beta value changed
 const int MATE = INFINITE_VALUE - 100;
+const int MATE_IN_MAX = MATE - MAX_DEPTH; // any score beyond this is a forced mate
 
 // Square values
 enum {
@@ -50,6 +53,10 @@ enum {
 // Side colors
 enum { WHITE, BLACK };
 
+// Game phases for tapered evaluation
+enum { MIDGAME, ENDGAME, PHASE_NB };
+const int MAX_PHASE = 24;
+
 // Files and Ranks
 enum { FILE_A, FILE_B, FILE_C, FILE_D, FILE_E, FILE_F, FILE_G, FILE_H };
 enum { RANK_1, RANK_2, RANK_3, RANK_4, RANK_5, RANK_6, RANK_7, RANK_8 };
@@ -72,19 +79,31 @@ enum { WKCA = 1, WQCA = 2, BKCA = 4, BQCA = 8 };
 
 // Structures
 
-// The Move structure holds information about the move
-struct Move {
-	Square from;
-	Square to;
-	Piece captured;
-	Piece promotion;
-	bool castle;
-	MoveScore score; // for search ordering
+// A Move is packed into 16 bits: the from square in bits 0-5 and the to square in bits 6-11
+// as 64 based squares, the promotion piece type minus KNIGHT in bits 12-13 and the move type
+// in bits 14-15. Castling is stored as the king's move. A1A1 can't be played, so 0 is no move.
+typedef uint16_t Move;
+
+const Move MOVE_NONE = 0;
+
+// Move types
+enum { NORMAL, PROMOTION = 1 << 14, EN_PASSANT = 2 << 14, CASTLING = 3 << 14 };
+
+// The ExtMove structure pairs a move with its score for search ordering, only move lists need it
+struct ExtMove {
+	Move move;
+	MoveScore score;
 };
 
 // The MoveList structure contains all of the moves for a position and the count
 struct MoveList {
-	Move moves[MAX_POSITION_MOVES];
+	ExtMove moves[MAX_POSITION_MOVES];
+	int count;
+};
+
+// The PVLine structure holds a principal variation
+struct PVLine {
+	Move moves[MAX_DEPTH];
 	int count;
 };
 
@@ -92,33 +111,41 @@ struct MoveList {
 // This is needed to undo moves and makes up the history stack
 struct Snapshot {
 	Key id;
-	Byte castling_perms;
-	Square en_passant_target;
 	Move move;
-	int rule50;
+	int16_t rule50;
+	Byte castling_perms;
+	int8_t en_passant_target;
+	int8_t captured; // piece taken by the move, NO_PIECE for en-passant
+};
+
+// The Counter structure is a statistic which only its own thread writes, while other threads
+// read it during the search. Relaxed loads and stores compile to plain moves, so counting
+// costs the same as with a plain integer, but reading it from another thread is no data race.
+struct Counter {
+	atomic<U64> value;
+
+	Counter(U64 n = 0) : value(n) {}
+	Counter(const Counter& c) : value(U64(c)) {}
+	Counter& operator=(const Counter& c) { value.store(U64(c), memory_order_relaxed); return *this; }
+	operator U64() const { return value.load(memory_order_relaxed); }
+	void operator+=(U64 n) { value.store(U64(*this) + n, memory_order_relaxed); }
+	void operator++(int) { *this += 1; }
 };
 
 // The SearchInfo structure holds parameters for a search
 struct SearchInfo {
 	int start_time;
-	int stop_time;
+	int optimum_time; // milliseconds the search should normally take, set by the TimeManager
+	int maximum_time; // milliseconds after which the search stops in any case
 	int depth;
-	int moves_to_go;
-	long nodes;
+	int root_ply; // game ply of the root position, to get the distance from the root
 	bool timed_search;
 	bool quit;
-	bool stopped;
+	bool silent; // no info or bestmove output, for the bench
+	atomic<bool> stopped; // read by every search thread
 };
 
-extern Move create_move(Square from, Square to, Piece promotion = NO_PIECE, bool castle = false, int score = 0);
-
-
 extern int get_time();
 extern string print_move(Move m);
 
-// Global Functions
-/*
-extern Move create_move(Square from, Square to, Piece promotion = NO_PIECE, bool castle = false, int score = 0);
-
-*/
 #endif // !__TYPES_H__
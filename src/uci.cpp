@@ -4,8 +4,10 @@
 #include <string>
 #include <ctime>
 #include <thread>
+#include <algorithm>
 
 #include "uci.h"
+#include "timeman.h"
 
 // FEN string of the initial position
 const string start_FEN = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
@@ -21,9 +23,14 @@ const string start_FEN = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0
 	and not crash or burn time too much.
 */
 std::thread searchThread;
-Position pos;
+GameHistory game;
+Position pos(&game);
 SearchInfo info = {};
 
+// Current values of the UCI options, the bench changes them and puts them back
+int hash_mb = 16;
+int thread_count = 1;
+
 void stopSearch() {
 	// set search to stopped and join the thread.
 	info.stopped = true;
@@ -53,15 +60,20 @@ void UCI::loop() {
 		else if (token == "uci") {
 			cout << "id name " << NAME << endl;
 			cout << "id author " << AUTHOR << endl;
+			cout << "option name Hash type spin default 16 min 1 max 4096" << endl;
+			cout << "option name Threads type spin default 1 min 1 max 256" << endl;
+			cout << "option name Move Overhead type spin default 30 min 0 max 5000" << endl;
 			cout << "uciok" << endl;
 		}
 		else if (token == "ucinewgame") {
 			stopSearch();
 			pos.parse_fen(start_FEN);
+			TT.clear();
+			clear_search_data();
 		}
 		else if (token == "go")         go(iss);
 		else if (token == "position")   position(iss);
-		else if (token == "setoption")  {}
+		else if (token == "setoption")  setoption(iss);
 		else if (token == "stop")       stopSearch();
 		else if (token == "isready")    cout << "readyok" << endl;
 		else if (token == "p")          debug();
@@ -75,6 +87,9 @@ void UCI::loop() {
 			pos.parse_fen("rnbqkb1r/ppp2ppp/4p3/3p2P1/3P4/4PN2/PPP2PP1/RN1QKB1R b KQkq - 0 6");
 		}
 		else if (token == "perft")      do_perft(iss);
+		else if (token == "perftsuite") do_perft_suite(iss);
+		else if (token == "bench")      do_bench(iss);
+		else if (token == "stats")      print_stats();
 		else
 			cout << "Unknown command: " << command << endl;
 	}
@@ -96,19 +111,113 @@ void debug() {
 	generate_moves(pos, mlist);
 	pos.print_board();
 	print_move_list(mlist);
-	cout << "Evaluation in Centipawns: " << evaluate(pos) << endl;
-	cout << "is endgame? " << (is_endgame(pos) ? "true" : "false") << endl;
-	cout << "key: " << uppercase << hex << pos.history_stack[pos.game_ply].id << dec << endl;
+	cout << "Evaluation in Centipawns: " << evaluate(pos, pawn_hash) << endl;
+	cout << "game phase: " << pos.phase << "/" << MAX_PHASE << endl;
+	cout << "key: " << uppercase << hex << pos.pos_key << dec << endl;
+}
+
+// parse_int() reads a whole token as a number, it returns false for anything else
+// so that a bad argument only fails the command instead of the engine
+bool parse_int(const string& token, int& value) {
+	istringstream ss(token);
+	char rest;
+	return (ss >> value) && !(ss >> rest);
 }
 
+// do_perft() handles "perft [divide] <depth> [threads <n>] [hash <mb>]".
+// It uses every core and a 64MB hash unless told otherwise, "hash 0" turns the hash off.
 void do_perft(istringstream& iss) {
 	stopSearch();
 	string token;
-	iss >> token;
+	int depth = 0;
+	int perft_threads = max(int(std::thread::hardware_concurrency()), 1);
+	int perft_hash_mb = 64;
+	bool divide = false;
 
-	int depth = (token == "") ? 1 : stoi(token);
+	while (iss >> token) {
+		if (token == "divide")
+			divide = true;
+		else if (token == "threads") {
+			if (!(iss >> token) || !parse_int(token, perft_threads)) {
+				cout << "perft threads needs a number" << endl;
+				return;
+			}
+		}
+		else if (token == "hash") {
+			if (!(iss >> token) || !parse_int(token, perft_hash_mb)) {
+				cout << "perft hash needs a number" << endl;
+				return;
+			}
+		}
+		else if (!parse_int(token, depth) || depth < 1) {
+			cout << "Invalid perft argument: " << token << endl;
+			return;
+		}
+	}
+
+	if (!depth) {
+		cout << "perft needs a depth" << endl;
+		return;
+	}
 
-	cout << "Nodes at depth " << depth << ": " << perft(pos, depth) << endl;
+	run_perft(pos, depth, divide, min(max(perft_threads, 1), 256), min(max(perft_hash_mb, 0), 4096));
+}
+
+// do_perft_suite() handles "perftsuite [depth] [threads <n>] [hash <mb>]", the depth
+// limits every position of the suite. It returns false if any node count is wrong.
+bool do_perft_suite(istringstream& iss) {
+	stopSearch();
+	string token;
+	int depth = 0;
+	int perft_threads = max(int(std::thread::hardware_concurrency()), 1);
+	int perft_hash_mb = 64;
+
+	while (iss >> token) {
+		if (token == "threads") {
+			if (!(iss >> token) || !parse_int(token, perft_threads)) {
+				cout << "perftsuite threads needs a number" << endl;
+				return false;
+			}
+		}
+		else if (token == "hash") {
+			if (!(iss >> token) || !parse_int(token, perft_hash_mb)) {
+				cout << "perftsuite hash needs a number" << endl;
+				return false;
+			}
+		}
+		else if (!parse_int(token, depth)) {
+			cout << "Invalid perftsuite argument: " << token << endl;
+			return false;
+		}
+	}
+
+	return perft_suite(depth, min(max(perft_threads, 1), 256), min(max(perft_hash_mb, 0), 4096));
+}
+
+// do_bench() handles "bench [depth] [threads] [hash] [json]", by default depth 8 on one
+// thread with a 16MB hash. Only single threaded runs give a repeatable node count.
+void do_bench(istringstream& iss) {
+	stopSearch();
+	string token;
+	int args[3] = { 8, 1, 16 };
+	int count = 0;
+	bool json = false;
+
+	while (iss >> token) {
+		if (token == "json")
+			json = true;
+		else if (count < 3 && parse_int(token, args[count]))
+			count++;
+		else {
+			cout << "Invalid bench argument: " << token << endl;
+			return;
+		}
+	}
+
+	bench(min(max(args[0], 1), MAX_DEPTH - 1), min(max(args[1], 1), 256), min(max(args[2], 1), 4096), json);
+
+	TT.resize(hash_mb);
+	set_threads(thread_count);
 }
 
 // position() is called when engine receives the "position" UCI command.
@@ -145,7 +254,39 @@ void position(istringstream& iss) {
 
 // setoption() is called when engine receives the "setoption" UCI command. The
 // function updates the UCI option ("name") to the given value ("value").
-void setoption(istringstream& iss) {}
+void setoption(istringstream& iss) {
+
+	stopSearch();
+
+	string token, name, value;
+
+	iss >> token; // "name"
+
+	// Option names can contain spaces
+	while (iss >> token && token != "value")
+		name += (name.empty() ? "" : " ") + token;
+
+	iss >> value;
+
+	// Every option is a spin, so the value has to be a number
+	int n;
+	bool valid = parse_int(value, n);
+
+	if ((name == "Hash" || name == "Threads" || name == "Move Overhead") && !valid)
+		cout << "Invalid value for option " << name << ": " << value << endl;
+	else if (name == "Hash") {
+		hash_mb = min(max(n, 1), 4096);
+		TT.resize(hash_mb);
+	}
+	else if (name == "Threads") {
+		thread_count = min(max(n, 1), 256);
+		set_threads(thread_count);
+	}
+	else if (name == "Move Overhead")
+		Time.move_overhead = min(max(n, 0), 5000);
+	else
+		cout << "No such option: " << name << endl;
+}
 
 // go() is called when engine receives the "go" UCI command. The function sets
 // the thinking time and other parameters from the input string, and starts the search.
@@ -155,7 +296,7 @@ void go(istringstream& iss) {
 
 	string token;
 
-	int depth = MAX_DEPTH, movestogo = 30, movetime = -1;
+	int depth = MAX_DEPTH, movestogo = 0, movetime = -1;
 	int time = -1, inc = 0;
 
 	while (iss >> token) {
@@ -168,24 +309,11 @@ void go(istringstream& iss) {
 		else if (token == "movetime")                      iss >> movetime;
 	}
 
-	if (movetime != -1) {
-		time = movetime;
-		movestogo = 1;
-	}
-
 	info.start_time = get_time();
 	info.depth = depth;
 	info.stopped = false;
 
-	if (time != -1) {
-		time /= movestogo;
-		time -= 50;
-		info.stop_time = info.start_time + time + inc;
-		info.timed_search = true;
-	}
-
-	//cout << "time: " << time << " start: " << info.start_time << " stop: " << info.stop_time << " depth: " << info.depth << endl;
-	//cout << "Searching for " << info.stop_time - info.start_time << " seconds." << endl;
+	Time.init(info, time, inc, movestogo, movetime);
 	
 	//int start_time = get_time();
 	// search_position(pos, info);
@@ -196,11 +324,10 @@ void go(istringstream& iss) {
 	//cout << "finished in " << (end_time - start_time) << " milliseconds" << endl;
 }
 
-// Return the time in milliseconds
+// Return the time in milliseconds since the program started, from the monotonic clock
 int get_time() {
 	using namespace std::chrono;
-	milliseconds ms = duration_cast<milliseconds>(
-	    system_clock::now().time_since_epoch()
-	);
+	static const steady_clock::time_point start = steady_clock::now();
+	milliseconds ms = duration_cast<milliseconds>(steady_clock::now() - start);
 	return ms.count();
 }
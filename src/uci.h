@@ -10,6 +10,8 @@
 #include "movegen.h"
 #include "search.h"
 #include "perft.h"
+#include "bench.h"
+#include "tt.h"
 
 namespace UCI {
 	void init();
@@ -17,9 +19,13 @@ namespace UCI {
 }
 
 void debug();
+bool parse_int(const string& token, int& value);
 void do_perft(istringstream& iss);
+bool do_perft_suite(istringstream& iss);
+void do_bench(istringstream& iss);
 void position(istringstream& iss);
 void go(istringstream& iss);
+void setoption(istringstream& iss);
 void make_move(istringstream& iss);
 int get_time();
 
@@ -0,0 +1,176 @@
+// microbench times the engine primitives one at a time over the bench positions.
+// Build it with "make microbench". Every primitive is warmed up once and then timed
+// over several repetitions, and the fastest repetition is reported in nanoseconds per
+// call, one line per primitive so the output of two builds can be diffed.
+
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+#include "bitboard.h"
+#include "position.h"
+#include "movegen.h"
+#include "attack.h"
+#include "evaluate.h"
+#include "pawns.h"
+#include "search.h"
+#include "bench.h"
+
+using namespace std;
+
+const int REPETITIONS = 7;
+const int ROUNDS = 1000; // passes over the corpus in one repetition
+
+// The corpus keeps one position per bench FEN, each with its own history
+struct Sample {
+	const char* fen;
+	GameHistory history;
+	Position pos;
+	MoveList moves;
+};
+
+vector<Sample*> corpus;
+volatile U64 sink; // keeps the compiler from removing the timed calls
+
+// time_primitive() runs the function over the corpus and prints the best ns per call.
+// The function returns the number of calls it made on one position.
+template<typename F>
+void time_primitive(const char* name, F function) {
+
+	double best = 1e18;
+
+	for (int rep = 0; rep <= REPETITIONS; rep++) {
+
+		U64 calls = 0;
+		auto start = chrono::steady_clock::now();
+
+		for (int round = 0; round < ROUNDS; round++)
+			for (size_t i = 0; i < corpus.size(); i++)
+				calls += function(*corpus[i]);
+
+		double ns = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count();
+
+		// The first repetition only warms up the caches
+		if (rep > 0 && calls)
+			best = min(best, ns / calls);
+	}
+
+	printf("%-20s %10.2f ns/op\n", name, best);
+}
+
+// play_reversible() plays up to plies quiet piece moves, so the position gets a history
+// without a capture or pawn move which is_repetition() has to scan
+void play_reversible(Position& pos, int plies) {
+
+	for (int ply = 0; ply < plies; ply++) {
+		MoveList list;
+		list.count = 0;
+		generate(pos, list, QUIETS);
+
+		int i = 0;
+		while (i < list.count && (type_of(pos.piece_at(from_sq(list.moves[i].move))) == PAWN
+			|| move_type(list.moves[i].move) == CASTLING))
+			i++;
+
+		if (i == list.count)
+			return;
+
+		pos.make_move(list.moves[i].move);
+	}
+}
+
+int main() {
+
+	Bitboards::init();
+	Position::init();
+	MoveGen::init();
+	Eval::init();
+
+	for (int i = 0; i < bench_position_count; i++) {
+		Sample* s = new Sample();
+		s->fen = bench_positions[i];
+		s->pos.set_history(&s->history);
+		s->pos.parse_fen(s->fen);
+		s->moves.count = 0;
+		generate_moves(s->pos, s->moves);
+		corpus.push_back(s);
+	}
+
+	printf("%d positions, %d repetitions of %d rounds\n", (int)corpus.size(), REPETITIONS, ROUNDS);
+
+	time_primitive("make_undo_move", [](Sample& s) {
+		for (int i = 0; i < s.moves.count; i++) {
+			s.pos.make_move(s.moves.moves[i].move);
+			s.pos.undo_move();
+		}
+		return s.moves.count;
+	});
+
+	time_primitive("generate_moves", [](Sample& s) {
+		MoveList list;
+		list.count = 0;
+		generate_moves(s.pos, list);
+		sink += list.count;
+		return 1;
+	});
+
+	time_primitive("generate_quiets", [](Sample& s) {
+		MoveList list;
+		list.count = 0;
+		generate(s.pos, list, QUIETS);
+		sink += list.count;
+		return 1;
+	});
+
+	time_primitive("generate_captures", [](Sample& s) {
+		MoveList list;
+		list.count = 0;
+		generate_captures(s.pos, list);
+		sink += list.count;
+		return 1;
+	});
+
+	time_primitive("square_attacked", [](Sample& s) {
+		int attacked = 0;
+		for (Square sq = 0; sq < 64; sq++)
+			attacked += square_attacked(s.pos, to120(sq), !s.pos.to_move);
+		sink += attacked;
+		return 64;
+	});
+
+	time_primitive("in_check", [](Sample& s) {
+		sink += in_check(s.pos);
+		return 1;
+	});
+
+	// The corpus fits in the pawn table, so after the warm up every structure is found
+	time_primitive("evaluate_pawn_hit", [](Sample& s) {
+		sink += evaluate(s.pos, pawn_hash);
+		return 1;
+	});
+
+	// The entry of the structure is emptied first, so the pawns are evaluated every time
+	time_primitive("evaluate_pawn_miss", [](Sample& s) {
+		pawn_hash.entries[s.pos.pawn_key & (PAWN_TABLE_SIZE - 1)].key = 0;
+		sink += evaluate(s.pos, pawn_hash);
+		return 1;
+	});
+
+	// A freshly set up position has no history, play some moves so the scan has work.
+	// The positions are set up again by the parse_fen timing below.
+	for (size_t i = 0; i < corpus.size(); i++)
+		play_reversible(corpus[i]->pos, 12);
+
+	time_primitive("is_repetition", [](Sample& s) {
+		sink += is_repetition(s.pos);
+		return 1;
+	});
+
+	time_primitive("parse_fen", [](Sample& s) {
+		s.pos.parse_fen(s.fen);
+		sink += s.pos.pos_key;
+		return 1;
+	});
+
+	return 0;
+}